@@ -0,0 +1,36 @@
+#pragma once
+
+// Process-wide heap allocation counter, for benchmarks that need to show
+// what a phase allocates.
+//
+// Including this header replaces the global operator new/delete, so it
+// belongs in exactly one translation unit of a benchmark or tool binary,
+// never in a library header. Read alloc_count::heap() before and after the
+// code being measured.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_count {
+
+inline std::atomic<uint64_t> g_heap{0};
+
+inline uint64_t heap() { return g_heap.load(std::memory_order_relaxed); }
+
+} // namespace alloc_count
+
+// Out of line, so GCC cannot inline malloc and free into callers and then
+// see free() take memory from operator new (-Wmismatched-new-delete).
+[[gnu::noinline]] void* operator new(std::size_t n) {
+    alloc_count::g_heap.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) { return operator new(n); }
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
@@ -0,0 +1,92 @@
+#pragma once
+
+// Bump allocator for the nodes of one compilation unit.
+//
+// make<T>() carves objects out of large blocks with a pointer bump, so a
+// parse costs one malloc per block instead of one per node, and sibling
+// nodes end up next to each other in memory. Nothing is freed
+// individually: reset() or the destructor drops every block at once.
+// Destructors are never run, so arena objects must not own resources
+// (strings are copied in with copy() and held as string_views).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 << 10) : m_blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        ++m_allocs;
+        uintptr_t p = (uintptr_t(m_cur) + align - 1) & ~uintptr_t(align - 1);
+        if (!m_cur || p + size > uintptr_t(m_end)) {
+            grow(size + align);
+            p = (uintptr_t(m_cur) + align - 1) & ~uintptr_t(align - 1);
+        }
+        m_cur = reinterpret_cast<char*>(p + size);
+        return reinterpret_cast<void*>(p);
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    std::string_view copy(std::string_view s) {
+        if (s.empty()) return {};
+        char* p = static_cast<char*>(allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        return {p, s.size()};
+    }
+
+    // Releases everything allocated so far, keeping the first block for
+    // the next unit.
+    void reset() {
+        m_allocs = 0;
+        if (m_blocks.empty()) return;
+        m_blocks.resize(1);
+        m_cur = m_blocks[0].data.get();
+        m_end = m_cur + m_blocks[0].size;
+    }
+
+    // Objects and strings carved out since the last reset().
+    size_t allocations() const { return m_allocs; }
+
+    // Heap blocks currently held; each was one malloc.
+    size_t blocks() const { return m_blocks.size(); }
+
+    // Bytes reserved from the heap.
+    size_t bytes() const {
+        size_t n = 0;
+        for (auto& b : m_blocks) n += b.size;
+        return n;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void grow(size_t atLeast) {
+        size_t n = std::max(m_blockSize, atLeast);
+        m_blocks.push_back({std::unique_ptr<char[]>(new char[n]), n});
+        m_cur = m_blocks.back().data.get();
+        m_end = m_cur + n;
+    }
+
+    size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    char* m_cur = nullptr;
+    char* m_end = nullptr;
+    size_t m_allocs = 0;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+// Helpers shared by the benchmark programs under dead/bench and toy/bench.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double seconds_since(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+struct ChildResult {
+    bool ok = false;
+    double seconds = 0.0;
+    long peak_rss_kb = 0;
+};
+
+// Runs fn() in a forked child and reports the seconds it returned together
+// with the child's own peak RSS, so each measured path starts from a clean heap.
+template <class F>
+ChildResult run_in_child(F&& fn) {
+    ChildResult res;
+    int fds[2];
+    if (pipe(fds) != 0) return res;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        double secs = fn();
+        (void)!write(fds[1], &secs, sizeof(secs));
+        _exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return res;
+    }
+
+    res.ok = read(fds[0], &res.seconds, sizeof(res.seconds)) == sizeof(res.seconds);
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage ru {};
+    wait4(pid, &status, 0, &ru);
+    res.peak_rss_kb = ru.ru_maxrss;
+    res.ok = res.ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    return res;
+}
+
+// Writes `line` repeatedly to a temporary file until it reaches `bytes`.
+inline std::string write_temp_input(const std::string& line, size_t bytes, const char* suffix) {
+    std::string path = "/tmp/bench_input_" + std::to_string(getpid()) + suffix;
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return {};
+    std::string block;
+    while (block.size() < (1u << 20)) block += line;
+    for (size_t written = 0; written < bytes; written += block.size()) {
+        std::fwrite(block.data(), 1, block.size(), f);
+    }
+    std::fclose(f);
+    return path;
+}
+
+// One user-space hardware counter (branch misses, instructions, ...) for the
+// calling thread. available() is false where perf events are not permitted,
+// e.g. in containers; callers then report timings only.
+class PerfCounter {
+public:
+    explicit PerfCounter(uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+    ~PerfCounter() {
+        if (m_fd >= 0) close(m_fd);
+    }
+
+    bool available() const { return m_fd >= 0; }
+
+    void start() {
+        if (m_fd < 0) return;
+        ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t stop() {
+        if (m_fd < 0) return 0;
+        ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value = 0;
+        if (read(m_fd, &value, sizeof(value)) != sizeof(value)) return 0;
+        return value;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+} // namespace bench
@@ -0,0 +1,80 @@
+#pragma once
+
+// Keyword recognition through a perfect hash chosen at compile time.
+//
+// make_keywords searches for a seed under which every keyword lands in its
+// own slot of a power-of-two table, so find() is one hash, one slot load
+// and one comparison no matter how many keywords a lexer defines. Lengths
+// outside the keyword range are rejected before hashing.
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace lex {
+
+constexpr uint32_t keyword_hash(std::string_view s, uint32_t seed) {
+    uint32_t h = seed ^ (uint32_t(s.size()) * 0x9E3779B1u);
+    h ^= uint32_t((unsigned char)s.front()) * 0x85EBCA6Bu;
+    h ^= uint32_t((unsigned char)s[s.size() / 2]) * 0x27D4EB2Fu;
+    h ^= uint32_t((unsigned char)s.back()) * 0xC2B2AE35u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+constexpr size_t keyword_slots(size_t n) {
+    size_t m = 2;
+    while (m < 2 * n) m <<= 1;
+    return m;
+}
+
+template <class Kind, size_t N>
+struct KeywordTable {
+    static constexpr size_t Slots = keyword_slots(N);
+
+    std::pair<std::string_view, Kind> words[N] {};
+    uint8_t slot[Slots] {};  // index into words + 1, 0 when empty
+    uint32_t seed = 0;
+    size_t minLen = 0, maxLen = 0;
+
+    constexpr std::optional<Kind> find(std::string_view s) const {
+        if (s.size() < minLen || s.size() > maxLen) return std::nullopt;
+        uint8_t i = slot[keyword_hash(s, seed) & (Slots - 1)];
+        if (i == 0 || words[i - 1].first != s) return std::nullopt;
+        return words[i - 1].second;
+    }
+};
+
+template <class Kind, size_t N>
+constexpr KeywordTable<Kind, N> make_keywords(const std::pair<std::string_view, Kind> (&kws)[N]) {
+    static_assert(N > 0 && N < 255, "keyword table holds 1..254 entries");
+    KeywordTable<Kind, N> t {};
+    t.minLen = kws[0].first.size();
+    for (size_t i = 0; i < N; ++i) {
+        t.words[i] = kws[i];
+        if (kws[i].first.empty()) throw "keywords must be non-empty";
+        if (kws[i].first.size() < t.minLen) t.minLen = kws[i].first.size();
+        if (kws[i].first.size() > t.maxLen) t.maxLen = kws[i].first.size();
+    }
+
+    for (uint32_t seed = 0; seed < (1u << 16); ++seed) {
+        for (auto& s : t.slot) s = 0;
+        bool ok = true;
+        for (size_t i = 0; i < N && ok; ++i) {
+            auto& s = t.slot[keyword_hash(kws[i].first, seed) & (t.Slots - 1)];
+            if (s != 0) ok = false;
+            else s = uint8_t(i + 1);
+        }
+        if (ok) {
+            t.seed = seed;
+            return t;
+        }
+    }
+    throw "no perfect hash seed found for this keyword set";
+}
+
+} // namespace lex
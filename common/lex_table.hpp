@@ -0,0 +1,146 @@
+#pragma once
+
+// Table-driven lexing shared by the toy lexers.
+//
+// char_class maps every byte to the small class alphabet the DFA runs on,
+// built at compile time so lexing never consults the C locale. Dfa holds
+// the transitions for identifiers and numeric literals; single-character
+// operators come from a per-lexer PunctTable, so adding an operator is a
+// one-line edit to that lexer's table.
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+#include "scan.hpp"
+
+namespace lex {
+
+enum CharClass : uint8_t {
+    C_Other,
+    C_Space,
+    C_Digit,
+    C_Alpha,
+    C_Underscore,
+    C_Dot,
+    ClassCount
+};
+
+constexpr std::array<uint8_t, 256> make_class_table() {
+    std::array<uint8_t, 256> t {};
+    for (int c = 0; c < 256; ++c) {
+        if (scan::is_space(c)) t[c] = C_Space;
+        else if (scan::is_digit(c)) t[c] = C_Digit;
+        else if (scan::is_alpha(c)) t[c] = C_Alpha;
+        else if (c == '_') t[c] = C_Underscore;
+        else if (c == '.') t[c] = C_Dot;
+        else t[c] = C_Other;
+    }
+    return t;
+}
+
+inline constexpr std::array<uint8_t, 256> char_class = make_class_table();
+
+inline uint8_t classOf(char c) { return char_class[(unsigned char)c]; }
+
+/* ------------------- DFA ------------------- */
+// S_Done is never entered: a transition to it ends the token before the byte.
+enum State : uint8_t {
+    S_Start,
+    S_Ident,
+    S_Int,
+    S_DotLead,  // '.' seen first, a digit must follow
+    S_Frac,
+    S_Done,
+    StateCount
+};
+
+enum class Shape : uint8_t { None, Identifier, Number };
+
+// Self-looping states name the scan:: kernel that can skip their run.
+enum class Run : uint8_t { None, Ident, Alnum, Digits };
+
+struct DfaOptions {
+    bool underscoreIdent = true;  // '_' may start and continue an identifier
+    bool fractions = true;        // numbers may contain one '.'
+};
+
+struct Dfa {
+    uint8_t next[StateCount][ClassCount];
+    Shape accept[StateCount];
+    Run run[StateCount];
+};
+
+constexpr Dfa make_dfa(DfaOptions opt) {
+    Dfa d {};
+    for (auto& row : d.next)
+        for (auto& cell : row) cell = S_Done;
+    for (auto& a : d.accept) a = Shape::None;
+    for (auto& r : d.run) r = Run::None;
+
+    d.next[S_Start][C_Alpha] = S_Ident;
+    d.next[S_Start][C_Digit] = S_Int;
+    d.next[S_Ident][C_Alpha] = S_Ident;
+    d.next[S_Ident][C_Digit] = S_Ident;
+    d.next[S_Int][C_Digit] = S_Int;
+    if (opt.underscoreIdent) {
+        d.next[S_Start][C_Underscore] = S_Ident;
+        d.next[S_Ident][C_Underscore] = S_Ident;
+    }
+    if (opt.fractions) {
+        d.next[S_Start][C_Dot] = S_DotLead;
+        d.next[S_DotLead][C_Digit] = S_Frac;
+        d.next[S_Int][C_Dot] = S_Frac;
+        d.next[S_Frac][C_Digit] = S_Frac;
+    }
+
+    d.accept[S_Ident] = Shape::Identifier;
+    d.accept[S_Int] = Shape::Number;
+    d.accept[S_Frac] = Shape::Number;
+
+    d.run[S_Ident] = opt.underscoreIdent ? Run::Ident : Run::Alnum;
+    d.run[S_Int] = Run::Digits;
+    d.run[S_Frac] = Run::Digits;
+    return d;
+}
+
+struct Match {
+    const char* end;
+    Shape shape;
+};
+
+// Longest identifier or number starting at p. Shape::None means the byte at
+// p does not start one; the caller then consults its PunctTable.
+inline Match match(const Dfa& dfa, const char* p, const char* end) {
+    const char* start = p;
+    uint8_t s = S_Start;
+    while (p < end) {
+        uint8_t n = dfa.next[s][classOf(*p)];
+        if (n == S_Done) break;
+        s = n;
+        ++p;
+        switch (dfa.run[s]) {
+            case Run::Ident: p = scan::skip_ident(p, end); break;
+            case Run::Alnum: p = scan::skip_alnum(p, end); break;
+            case Run::Digits: p = scan::skip_digits(p, end); break;
+            case Run::None: break;
+        }
+    }
+    if (dfa.accept[s] == Shape::None) return {start, Shape::None};
+    return {p, dfa.accept[s]};
+}
+
+/* ------------------- Single-character operators ------------------- */
+template <class Kind>
+using PunctTable = std::array<Kind, 256>;
+
+template <class Kind>
+constexpr PunctTable<Kind> make_punct_table(std::initializer_list<std::pair<char, Kind>> ops, Kind invalid) {
+    PunctTable<Kind> t {};
+    for (auto& k : t) k = invalid;
+    for (auto& [c, k] : ops) t[(unsigned char)c] = k;
+    return t;
+}
+
+} // namespace lex
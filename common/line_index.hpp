@@ -0,0 +1,47 @@
+#pragma once
+
+// Offset -> line/column for diagnostics. Tokens and AST nodes only carry a
+// 32-bit byte offset; the table of line starts is built the first time a
+// message actually needs a line number, so inputs that produce no
+// diagnostics never pay for it.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace lex {
+
+struct LineCol {
+    uint32_t line;  // 1-based
+    uint32_t col;   // 1-based, in bytes
+};
+
+class LineIndex {
+public:
+    explicit LineIndex(std::string_view src) : m_src(src) {}
+
+    LineCol at(uint32_t offset) const {
+        if (m_starts.empty()) build();
+        auto it = std::upper_bound(m_starts.begin(), m_starts.end(), offset);
+        uint32_t line = uint32_t(it - m_starts.begin());
+        return {line, offset - m_starts[line - 1] + 1};
+    }
+
+private:
+    void build() const {
+        m_starts.push_back(0);
+        const char* p = m_src.data();
+        const char* end = p + m_src.size();
+        while (const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p))) {
+            m_starts.push_back(uint32_t(nl + 1 - m_src.data()));
+            p = nl + 1;
+        }
+    }
+
+    std::string_view m_src;
+    mutable std::vector<uint32_t> m_starts;
+};
+
+} // namespace lex
@@ -0,0 +1,24 @@
+#pragma once
+
+// NASM text for x86-64 Linux programs that run without libc: execution
+// starts at _start and ends with the exit system call. The dead compiler
+// emits whole programs this way and toy lowers its IR through the same
+// entry and exit sequences.
+
+#include <ostream>
+#include <string_view>
+
+namespace nasm {
+
+inline void emit_start(std::ostream& output) {
+    output << "global _start\n_start:\n";
+}
+
+// code is any rdi source operand: an immediate, a register or memory.
+inline void emit_exit(std::ostream& output, std::string_view code) {
+    output << "    mov rax, 60\n";
+    output << "    mov rdi, " << code << "\n";
+    output << "    syscall\n";
+}
+
+} // namespace nasm
@@ -0,0 +1,58 @@
+#pragma once
+
+// Dispatch on a node's kind tag, for tree passes written as a set of lambdas.
+//
+// A program's node types derive from one base whose `kind` member is an
+// enum numbered 0, 1, ... in a fixed order. visit_kind<Nodes...>(node, f)
+// calls f with node cast to the type at its kind's position in Nodes: one
+// switch on the tag, an indexed jump, in place of a dynamic_cast per
+// candidate type. With Overloaded, f is one lambda per node type:
+//
+//     visit_kind<NumberExpr, BinaryExpr>(e, ast::Overloaded{
+//         [](const NumberExpr &n) { ... },
+//         [](const BinaryExpr &b) { ... },
+//     });
+//
+// Every overload f offers must return the same type; a generic
+// `const auto&` overload catches the rest.
+
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+namespace ast {
+
+// Lambdas merged into one overload set.
+template <class... Fs>
+struct Overloaded : Fs... { using Fs::operator()...; };
+template <class... Fs>
+Overloaded(Fs...) -> Overloaded<Fs...>;
+
+namespace detail {
+
+template <size_t I, class... Nodes, class Base, class F>
+decltype(auto) visit_as(Base &node, F &f) {
+    using Node = std::tuple_element_t<I, std::tuple<Nodes...>>;
+    using Target = std::conditional_t<std::is_const_v<Base>, const Node, Node>;
+    return f(static_cast<Target&>(node));
+}
+
+} // namespace detail
+
+// Calls f with node as Nodes[node.kind]; Nodes are listed in kind order.
+template <class... Nodes, class Base, class F>
+decltype(auto) visit_kind(Base &node, F &&f) {
+    constexpr size_t n = sizeof...(Nodes);
+    static_assert(n >= 1 && n <= 8, "visit_kind: add cases for more node kinds");
+#define AST_VISIT_CASE(I) \
+    case I: if constexpr (I < n) return detail::visit_as<I, Nodes...>(node, f); else break;
+    switch (size_t(node.kind)) {
+        AST_VISIT_CASE(0) AST_VISIT_CASE(1) AST_VISIT_CASE(2) AST_VISIT_CASE(3)
+        AST_VISIT_CASE(4) AST_VISIT_CASE(5) AST_VISIT_CASE(6) AST_VISIT_CASE(7)
+    }
+#undef AST_VISIT_CASE
+    throw std::logic_error("AST: bad node kind");
+}
+
+} // namespace ast
@@ -0,0 +1,43 @@
+#pragma once
+
+// In-place numeric literal parsing for the lexers. Literals are parsed
+// straight from the source span with std::from_chars, so there is no
+// temporary std::string and no locale lookup. Pure-integer literals that fit
+// in 18 digits are accumulated directly and never go through the
+// floating-point parser.
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <system_error>
+
+namespace lex {
+
+// s is a literal already delimited by the lexer: digits with at most one '.'.
+inline bool parse_number(std::string_view s, double& out) {
+    if (!s.empty() && s.size() <= 18) {
+        uint64_t v = 0;
+        size_t i = 0;
+        for (; i < s.size(); ++i) {
+            unsigned d = unsigned(s[i] - '0');
+            if (d > 9) break;
+            v = v * 10 + d;
+        }
+        if (i == s.size()) {
+            out = double(v);
+            return true;
+        }
+    }
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+// Decimal integer literal into any integer type; false when the literal does
+// not fit rather than throwing the way std::stoi does.
+template <class Int>
+inline bool parse_int(std::string_view s, Int& out) {
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+} // namespace lex
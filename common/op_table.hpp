@@ -0,0 +1,56 @@
+#pragma once
+
+// Infix operator tables for precedence-climbing (Pratt) expression parsers.
+//
+// A parser lists its binary operators once, with a precedence and an
+// associativity, and make_op_table turns them into binding powers indexed
+// by token kind. The whole expression grammar is then one loop:
+//
+//     lhs = prefix();
+//     while (table[peek()].lbp > minBp) { op = next(); lhs = {op, lhs, expr(op.rbp)}; }
+//
+// A chain of operators at one level is consumed by that loop without a call
+// per precedence level, and a new operator is a one-line table entry.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+namespace parse {
+
+enum class Assoc : uint8_t { Left, Right };
+
+struct Infix {
+    uint8_t lbp = 0;  // 0: not an infix operator
+    uint8_t rbp = 0;  // minimum binding power of the right operand
+    char op = 0;
+};
+
+template <class Kind>
+struct OpSpec {
+    Kind kind;
+    char op;
+    uint8_t prec;  // 1 binds loosest
+    Assoc assoc = Assoc::Left;
+};
+
+template <class Kind>
+struct OpTable {
+    std::array<Infix, 256> ops {};
+    constexpr const Infix& operator[](Kind k) const { return ops[size_t(k) & 0xff]; }
+};
+
+template <class Kind>
+constexpr OpTable<Kind> make_op_table(std::initializer_list<OpSpec<Kind>> specs) {
+    OpTable<Kind> t {};
+    for (auto& s : specs) {
+        if (s.prec < 1 || s.prec > 100) throw "operator precedence must be 1..100";
+        if (size_t(s.kind) > 0xff) throw "token kind does not fit the operator table";
+        uint8_t lbp = uint8_t(2 * s.prec);
+        t.ops[size_t(s.kind)] = {lbp, uint8_t(s.assoc == Assoc::Left ? lbp : lbp - 1), s.op};
+    }
+    return t;
+}
+
+} // namespace parse
@@ -0,0 +1,81 @@
+#pragma once
+
+// Chunked lexing on a ThreadPool.
+//
+// The source is cut just after statement terminators, which in the toy and
+// dead languages never occur inside a token or an open construct (there are
+// no strings or comments), so each chunk lexes exactly as it would in place.
+// Chunks are lexed concurrently and their token streams concatenated in
+// source order. If any chunk fails, the error of the earliest failing chunk
+// is rethrown: it is the same first error a serial lexer would report.
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace lex {
+
+// Offsets that cut src into about `parts` pieces, each ending right after a
+// `term` byte (the last piece ends at src.size()). Always starts with 0.
+inline std::vector<size_t> split_after(std::string_view src, size_t parts, char term = ';') {
+    std::vector<size_t> cuts {0};
+    if (parts < 2) {
+        cuts.push_back(src.size());
+        return cuts;
+    }
+    size_t target = src.size() / parts;
+    for (size_t i = 1; i < parts; ++i) {
+        size_t from = std::max(cuts.back(), i * target);
+        size_t at = src.find(term, from);
+        if (at == std::string_view::npos) break;
+        if (at + 1 > cuts.back() && at + 1 < src.size()) cuts.push_back(at + 1);
+    }
+    cuts.push_back(src.size());
+    return cuts;
+}
+
+// Runs lexChunk(std::string_view chunk) on every chunk and returns the
+// per-chunk results in source order. lexChunk reports errors by throwing;
+// results may refer to chunk, which views src.
+template <class LexChunk>
+auto lex_chunks(std::string_view src, ThreadPool& pool, LexChunk lexChunk, size_t chunksPerThread = 4)
+    -> std::vector<std::invoke_result_t<LexChunk&, std::string_view>> {
+    using R = std::invoke_result_t<LexChunk&, std::string_view>;
+    std::vector<size_t> cuts = split_after(src, size_t(pool.size()) * chunksPerThread);
+
+    std::vector<std::future<R>> parts;
+    parts.reserve(cuts.size() - 1);
+    for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+        std::string_view chunk = src.substr(cuts[i], cuts[i + 1] - cuts[i]);
+        parts.push_back(pool.submit([chunk, &lexChunk] { return lexChunk(chunk); }));
+    }
+    // Let every chunk finish before anything is rethrown: they all read src.
+    for (auto& f : parts) f.wait();
+
+    std::vector<R> results;
+    results.reserve(parts.size());
+    for (auto& f : parts) results.push_back(f.get());
+    return results;
+}
+
+// lex_chunks for lexers that return std::vector<Tok>, concatenated in order.
+template <class Tok, class LexChunk>
+std::vector<Tok> lex_parallel(std::string_view src, ThreadPool& pool, LexChunk lexChunk,
+                              size_t chunksPerThread = 4) {
+    std::vector<std::vector<Tok>> results = lex_chunks(src, pool, lexChunk, chunksPerThread);
+    size_t total = 0;
+    for (auto& r : results) total += r.size();
+
+    std::vector<Tok> out;
+    out.reserve(total);
+    for (auto& r : results) {
+        out.insert(out.end(), std::make_move_iterator(r.begin()), std::make_move_iterator(r.end()));
+    }
+    return out;
+}
+
+} // namespace lex
@@ -0,0 +1,198 @@
+#pragma once
+
+// Run scanners for the lexers: each skip_* returns the first position in
+// [p, end) whose byte is outside the class. The x86 kernels classify 16
+// (SSE2) or 32 (AVX2) bytes per step; the widest one the CPU supports is
+// picked once at startup, with a scalar fallback everywhere else.
+//
+// Classes follow the C locale and never call into <cctype>:
+//   space  ' ' \t \n \v \f \r
+//   digit  0-9
+//   alnum  A-Z a-z 0-9
+//   ident  A-Z a-z 0-9 _
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_HAVE_X86 1
+#else
+#define SCAN_HAVE_X86 0
+#endif
+
+namespace scan {
+
+enum class Class { Space, Digit, Alnum, Ident };
+
+constexpr bool is_space(unsigned char c) { return c == ' ' || unsigned(c - '\t') < 5u; }
+constexpr bool is_digit(unsigned char c) { return unsigned(c - '0') < 10u; }
+constexpr bool is_alpha(unsigned char c) { return unsigned((c | 0x20) - 'a') < 26u; }
+constexpr bool is_alnum(unsigned char c) { return is_alpha(c) || is_digit(c); }
+constexpr bool is_ident(unsigned char c) { return is_alnum(c) || c == '_'; }
+
+template <Class C>
+constexpr bool in_class(unsigned char c) {
+    if constexpr (C == Class::Space) return is_space(c);
+    else if constexpr (C == Class::Digit) return is_digit(c);
+    else if constexpr (C == Class::Alnum) return is_alnum(c);
+    else return is_ident(c);
+}
+
+template <Class C>
+inline const char* skip_scalar(const char* p, const char* end) {
+    while (p < end && in_class<C>((unsigned char)*p)) ++p;
+    return p;
+}
+
+#if SCAN_HAVE_X86
+
+namespace detail {
+
+// Unsigned byte range test: (v - lo) <= (hi - lo) computed with min_epu8.
+inline __m128i range16(__m128i v, char lo, char hi) {
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(char(hi - lo))), d);
+}
+
+template <Class C>
+inline __m128i match16(__m128i v) {
+    if constexpr (C == Class::Space) {
+        return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), range16(v, '\t', '\r'));
+    } else if constexpr (C == Class::Digit) {
+        return range16(v, '0', '9');
+    } else {
+        __m128i alpha = range16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i m = _mm_or_si128(alpha, range16(v, '0', '9'));
+        if constexpr (C == Class::Ident) m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        return m;
+    }
+}
+
+// Short runs dominate ordinary source, so the first bytes are checked one at
+// a time before the vector loop starts.
+constexpr int kScalarPrefix = 8;
+
+template <Class C>
+const char* skip_sse2(const char* p, const char* end) {
+    for (int i = 0; i < kScalarPrefix; ++i, ++p) {
+        if (p == end || !in_class<C>((unsigned char)*p)) return p;
+    }
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned miss = ~unsigned(_mm_movemask_epi8(match16<C>(v))) & 0xFFFFu;
+        if (miss) return p + __builtin_ctz(miss);
+        p += 16;
+    }
+    return skip_scalar<C>(p, end);
+}
+
+__attribute__((target("avx2")))
+inline __m256i range32(__m256i v, char lo, char hi) {
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(char(hi - lo))), d);
+}
+
+template <Class C>
+__attribute__((target("avx2")))
+inline __m256i match32(__m256i v) {
+    if constexpr (C == Class::Space) {
+        return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), range32(v, '\t', '\r'));
+    } else if constexpr (C == Class::Digit) {
+        return range32(v, '0', '9');
+    } else {
+        __m256i alpha = range32(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i m = _mm256_or_si256(alpha, range32(v, '0', '9'));
+        if constexpr (C == Class::Ident) m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        return m;
+    }
+}
+
+template <Class C>
+__attribute__((target("avx2")))
+const char* skip_avx2(const char* p, const char* end) {
+    for (int i = 0; i < kScalarPrefix; ++i, ++p) {
+        if (p == end || !in_class<C>((unsigned char)*p)) return p;
+    }
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned miss = ~unsigned(_mm256_movemask_epi8(match32<C>(v)));
+        if (miss) return p + __builtin_ctz(miss);
+        p += 32;
+    }
+    return skip_sse2<C>(p, end);
+}
+
+} // namespace detail
+
+#endif // SCAN_HAVE_X86
+
+enum class Isa { Scalar, SSE2, AVX2 };
+
+using SkipFn = const char* (*)(const char*, const char*);
+
+struct Kernels {
+    Isa isa;
+    SkipFn space, digits, alnum, ident;
+};
+
+inline Kernels kernels_for(Isa isa) {
+#if SCAN_HAVE_X86
+    if (isa == Isa::AVX2) {
+        return {isa, detail::skip_avx2<Class::Space>, detail::skip_avx2<Class::Digit>,
+                detail::skip_avx2<Class::Alnum>, detail::skip_avx2<Class::Ident>};
+    }
+    if (isa == Isa::SSE2) {
+        return {isa, detail::skip_sse2<Class::Space>, detail::skip_sse2<Class::Digit>,
+                detail::skip_sse2<Class::Alnum>, detail::skip_sse2<Class::Ident>};
+    }
+#endif
+    return {Isa::Scalar, skip_scalar<Class::Space>, skip_scalar<Class::Digit>,
+            skip_scalar<Class::Alnum>, skip_scalar<Class::Ident>};
+}
+
+// Best kernels for this CPU. SCAN_ISA=scalar|sse2|avx2 caps the choice,
+// which is how the benchmarks compare the paths on one machine.
+inline Isa detect_isa() {
+    Isa best = Isa::Scalar;
+#if SCAN_HAVE_X86
+    __builtin_cpu_init();
+    best = __builtin_cpu_supports("avx2") ? Isa::AVX2 : Isa::SSE2;
+#endif
+    if (const char* want = std::getenv("SCAN_ISA")) {
+        if (std::strcmp(want, "scalar") == 0) best = Isa::Scalar;
+        else if (std::strcmp(want, "sse2") == 0 && best == Isa::AVX2) best = Isa::SSE2;
+    }
+    return best;
+}
+
+inline const Kernels active = kernels_for(detect_isa());
+
+// Most runs in real source are a few bytes long, so the first byte is tested
+// inline before paying for the indirect call into the vector kernel.
+inline const char* skip_space(const char* p, const char* end) {
+    if (p == end || !is_space((unsigned char)*p)) return p;
+    return active.space(p + 1, end);
+}
+inline const char* skip_digits(const char* p, const char* end) {
+    if (p == end || !is_digit((unsigned char)*p)) return p;
+    return active.digits(p + 1, end);
+}
+inline const char* skip_alnum(const char* p, const char* end) {
+    if (p == end || !is_alnum((unsigned char)*p)) return p;
+    return active.alnum(p + 1, end);
+}
+inline const char* skip_ident(const char* p, const char* end) {
+    if (p == end || !is_ident((unsigned char)*p)) return p;
+    return active.ident(p + 1, end);
+}
+
+inline const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+} // namespace scan
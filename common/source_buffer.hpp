@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only view over an input file.
+// Regular files are mmap'd, so the bytes are never copied into the process;
+// pipes and other unmappable inputs fall back to a single owned string.
+class SourceBuffer {
+public:
+    explicit SourceBuffer(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Could not open input file: " << path << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                m_map = addr;
+                m_view = {static_cast<const char*>(addr), static_cast<size_t>(st.st_size)};
+                ::close(fd);
+                return;
+            }
+        }
+
+        char chunk[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, chunk, sizeof(chunk))) > 0) {
+            m_owned.append(chunk, n);
+        }
+        ::close(fd);
+        m_view = m_owned;
+    }
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    ~SourceBuffer() {
+        if (m_map) munmap(m_map, m_view.size());
+    }
+
+    std::string_view view() const { return m_view; }
+    size_t size() const { return m_view.size(); }
+
+private:
+    void* m_map = nullptr;
+    std::string m_owned;
+    std::string_view m_view;
+};
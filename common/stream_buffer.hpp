@@ -0,0 +1,68 @@
+#pragma once
+
+// Fixed-size input window over a file descriptor, for lexing pipes and other
+// inputs that are never materialized whole.
+//
+// The lexer reads tokens from [begin(), end()) and consume()s them. refill()
+// slides whatever is still unconsumed (at most the token being read) to the
+// front and reads more input behind it. Memory therefore stays at the
+// chosen capacity however long the input is, and a token that straddles a
+// read boundary is simply re-lexed once the rest of it has arrived.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <unistd.h>
+
+class StreamBuffer {
+public:
+    explicit StreamBuffer(int fd, size_t capacity = 1 << 16)
+        : m_fd(fd), m_cap(capacity), m_buf(new char[capacity]) {}
+
+    const char* begin() const { return m_buf.get() + m_start; }
+    const char* end() const { return m_buf.get() + m_end; }
+    bool eof() const { return m_eof; }
+
+    // True when the unconsumed bytes fill the whole window, i.e. one token is
+    // longer than the buffer.
+    bool full() const { return m_end - m_start == m_cap; }
+
+    // Absolute input offset of begin().
+    uint64_t offset() const { return m_base + m_start; }
+
+    void consume(const char* upto) { m_start = upto - m_buf.get(); }
+
+    // Reads more input behind the unconsumed bytes. Returns false at end of
+    // input, on a read error, or when the window is full.
+    bool refill() {
+        if (m_eof) return false;
+        if (m_start > 0) {
+            std::memmove(m_buf.get(), m_buf.get() + m_start, m_end - m_start);
+            m_end -= m_start;
+            m_base += m_start;
+            m_start = 0;
+        }
+        if (m_end == m_cap) return false;
+
+        ssize_t n;
+        do {
+            n = ::read(m_fd, m_buf.get() + m_end, m_cap - m_end);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            m_eof = true;
+            return false;
+        }
+        m_end += n;
+        return true;
+    }
+
+private:
+    int m_fd;
+    size_t m_cap;
+    std::unique_ptr<char[]> m_buf;
+    size_t m_start = 0, m_end = 0;
+    uint64_t m_base = 0;
+    bool m_eof = false;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+// Identifier interning: each distinct name gets a dense 32-bit id the first
+// time it is seen, so later stages compare names by integer equality and
+// index per-variable tables by id instead of hashing strings again.
+//
+// Names are copied once into an Arena and never move, so name(id) views
+// stay valid for the life of the table. Not thread-safe: concurrent lexers
+// must defer interning to a single thread.
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.hpp"
+
+using Symbol = uint32_t;
+
+class SymbolTable {
+public:
+    static constexpr Symbol kNone = ~Symbol(0);
+
+    SymbolTable() : m_text(16 << 10) {}
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    Symbol intern(std::string_view name) {
+        auto it = m_ids.find(name);
+        if (it != m_ids.end()) return it->second;
+        std::string_view stored = m_text.copy(name);
+        Symbol id = Symbol(m_names.size());
+        m_names.push_back(stored);
+        m_ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view name(Symbol id) const { return m_names[id]; }
+
+    // Ids handed out so far; every id is below this.
+    size_t size() const { return m_names.size(); }
+
+private:
+    Arena m_text;
+    std::vector<std::string_view> m_names;
+    std::unordered_map<std::string_view, Symbol> m_ids;
+};
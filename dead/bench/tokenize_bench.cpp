@@ -0,0 +1,153 @@
+// Compares the original stringstream + std::string token path against the
+// mmap'd SourceBuffer + string_view tokens, reporting MB/s and peak RSS, and
+// shows how tokenize_parallel scales from 1 to all hardware threads.
+//
+// Usage: tokenize_bench [input.dd] [size_mb]
+// Without an input file (or with "") a temporary one of size_mb (default 256)
+// is generated.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "bench.hpp"
+#include "source_buffer.hpp"
+#include "tokenization.hpp"
+
+namespace legacy {
+
+struct Token {
+    TokenType type;
+    std::optional<std::string> value {};
+};
+
+std::vector<Token> tokenize(const std::string& str) {
+    std::vector<Token> tokens;
+    std::string buf;
+
+    for (size_t i = 0; i < str.length(); i++) {
+        char c = str.at(i);
+
+        if (std::isalpha(c)) {
+            buf.push_back(c);
+            i++;
+            while (i < str.length() && std::isalnum(str.at(i))) {
+                buf.push_back(str.at(i));
+                i++;
+            }
+            i--;
+
+            if (buf == "return") {
+                tokens.push_back({.type = TokenType::_return});
+                buf.clear();
+                continue;
+            } else {
+                std::cerr << "Unknown identifier: " << buf << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (std::isdigit(c)) {
+            buf.push_back(c);
+            i++;
+            while (i < str.length() && std::isdigit(str.at(i))) {
+                buf.push_back(str.at(i));
+                i++;
+            }
+            i--;
+            tokens.push_back({.type = TokenType::int_lit, .value = buf});
+            buf.clear();
+        }
+        else if (c == ';') {
+            tokens.push_back({.type = TokenType::semi});
+        }
+        else if (std::isspace(c)) {
+            continue;
+        }
+        else {
+            std::cerr << "Unexpected character: " << c << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return tokens;
+}
+
+} // namespace legacy
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    bool generated = false;
+    size_t size_mb = argc > 2 ? std::stoul(argv[2]) : 256;
+
+    if (argc > 1 && *argv[1]) {
+        path = argv[1];
+    } else {
+        path = bench::write_temp_input("return 1234567;\n", size_mb << 20, ".dd");
+        generated = true;
+    }
+    if (path.empty()) {
+        std::cerr << "Could not create benchmark input\n";
+        return EXIT_FAILURE;
+    }
+
+    size_t bytes = 0;
+    {
+        SourceBuffer probe(path.c_str());
+        bytes = probe.size();
+    }
+
+    auto legacy_run = bench::run_in_child([&] {
+        auto t0 = bench::Clock::now();
+        std::string contents;
+        {
+            std::stringstream contents_stream;
+            std::fstream input(path, std::ios::in);
+            contents_stream << input.rdbuf();
+            contents = contents_stream.str();
+        }
+        auto tokens = legacy::tokenize(contents);
+        double secs = bench::seconds_since(t0);
+        return tokens.empty() && bytes ? -1.0 : secs;
+    });
+
+    auto mmap_run = bench::run_in_child([&] {
+        auto t0 = bench::Clock::now();
+        SourceBuffer contents(path.c_str());
+        auto tokens = tokenize(contents.view());
+        double secs = bench::seconds_since(t0);
+        return tokens.empty() && bytes ? -1.0 : secs;
+    });
+
+    std::vector<std::pair<unsigned, bench::ChildResult>> parallel_runs;
+    for (unsigned n = 1; n <= ThreadPool::default_threads(); n *= 2) {
+        parallel_runs.emplace_back(n, bench::run_in_child([&] {
+            ThreadPool pool(n);
+            auto t0 = bench::Clock::now();
+            SourceBuffer contents(path.c_str());
+            auto tokens = tokenize_parallel(contents.view(), pool);
+            double secs = bench::seconds_since(t0);
+            return tokens.empty() && bytes ? -1.0 : secs;
+        }));
+    }
+
+    double mb = bytes / double(1 << 20);
+    std::cout << "input: " << path << " (" << mb << " MB)\n";
+    auto report = [&](const char* name, const bench::ChildResult& r) {
+        if (!r.ok || r.seconds < 0) {
+            std::cout << name << ": failed\n";
+            return;
+        }
+        std::cout << name << ": " << mb / r.seconds << " MB/s, peak RSS "
+                  << r.peak_rss_kb / 1024 << " MB\n";
+    };
+    report("stringstream + std::string tokens", legacy_run);
+    report("mmap + string_view tokens        ", mmap_run);
+    for (auto& [n, r] : parallel_runs) {
+        std::string name = "mmap + parallel, " + std::to_string(n) + " thread(s)";
+        name.resize(33, ' ');
+        report(name.c_str(), r);
+    }
+
+    if (generated) unlink(path.c_str());
+    return EXIT_SUCCESS;
+}
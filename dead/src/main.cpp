@@ -2,74 +2,17 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
-#include <optional>
-#include <cctype>
 
-enum class TokenType {
-    _return,
-    int_lit,
-    semi
-};
+#include "nasm.hpp"
+#include "source_buffer.hpp"
+#include "tokenization.hpp"
 
-struct Token {
-    TokenType type;
-    std::optional<std::string> value {};
-};
-
-std::vector<Token> tokenize(const std::string& str) {
-    std::vector<Token> tokens;
-    std::string buf;
-
-    for (size_t i = 0; i < str.length(); i++) {
-        char c = str.at(i);
-
-        if (std::isalpha(c)) {
-            buf.push_back(c);
-            i++;
-            while (i < str.length() && std::isalnum(str.at(i))) {
-                buf.push_back(str.at(i));
-                i++;
-            }
-            i--;
-
-            if (buf == "return") {
-                tokens.push_back({.type = TokenType::_return});
-                buf.clear();
-                continue;
-            } else {
-                std::cerr << "Unknown identifier: " << buf << std::endl;
-                exit(EXIT_FAILURE);
-            }
-        }
-        else if (std::isdigit(c)) {
-            buf.push_back(c);
-            i++;
-            while (i < str.length() && std::isdigit(str.at(i))) {
-                buf.push_back(str.at(i));
-                i++;
-            }
-            i--;
-            tokens.push_back({.type = TokenType::int_lit, .value = buf});
-            buf.clear();
-        }
-        else if (c == ';') {
-            tokens.push_back({.type = TokenType::semi});
-        }
-        else if (std::isspace(c)) {
-            continue;
-        }
-        else {
-            std::cerr << "Unexpected character: " << c << std::endl;
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    return tokens;
-}
+// Inputs smaller than this are not worth the thread start-up.
+constexpr size_t parallel_tokenize_threshold = 8 << 20;
 
 std::string token_to_asm(const std::vector<Token>& tokens) {
     std::stringstream output;
-    output << "global _start\n_start:\n";
+    nasm::emit_start(output);
 
     for (size_t i = 0; i < tokens.size(); i++) {
         const Token& tok = tokens.at(i);
@@ -77,9 +20,7 @@ std::string token_to_asm(const std::vector<Token>& tokens) {
         if (tok.type == TokenType::_return) {
             if (i + 1 < tokens.size() && tokens.at(i + 1).type == TokenType::int_lit) {
                 if (i + 2 < tokens.size() && tokens.at(i + 2).type == TokenType::semi) {
-                    output << "    mov rax, 60\n";
-                    output << "    mov rdi, " << tokens.at(i + 1).value.value() << "\n";
-                    output << "    syscall\n";
+                    nasm::emit_exit(output, tokens.at(i + 1).value.value());
                 }
             }
         }
@@ -87,22 +28,67 @@ std::string token_to_asm(const std::vector<Token>& tokens) {
     return output.str();
 }
 
+// Same output as token_to_asm, generated while tokens stream in from fd.
+// Only the statement being matched is held, so memory stays constant.
+void stream_to_asm(int fd, std::ostream& out, std::ostream& echo) {
+    StreamTokenizer tokenizer(fd);
+    std::stringstream block;
+    nasm::emit_start(block);
+
+    int matched = 0; // tokens of "return <int_lit> ;" seen so far
+    std::string code;
+    try {
+        while (auto tok = tokenizer.next()) {
+            if (matched == 1 && tok->type == TokenType::int_lit) {
+                code = tok->value.value();
+                matched = 2;
+            } else if (matched == 2 && tok->type == TokenType::semi) {
+                nasm::emit_exit(block, code);
+                matched = 0;
+            } else {
+                matched = tok->type == TokenType::_return ? 1 : 0;
+            }
+
+            if (block.tellp() > 0) {
+                out << block.str();
+                echo << block.str();
+                block.str("");
+            }
+        }
+    } catch (const TokenizeError& e) {
+        std::cerr << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    echo << std::endl;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 2) {
         std::cerr << "Incorrect usage.\n";
         std::cerr << "Usage: dead <input.dd>\n";
+        std::cerr << "       dead -    (stream the program from stdin)\n";
         return EXIT_FAILURE;
     }
 
-    std::string contents;
-    {
-        std::stringstream contents_stream;
-        std::fstream input(argv[1], std::ios::in);
-        contents_stream << input.rdbuf();
-        contents = contents_stream.str();
+    if (std::string_view(argv[1]) == "-") {
+        {
+            std::fstream file("out.asm", std::ios::out);
+            stream_to_asm(STDIN_FILENO, file, std::cout);
+        }
+        system("nasm -f elf64 out.asm -o out.o");
+        system("ld out.o -o out");
+        return EXIT_SUCCESS;
     }
 
-    std::vector<Token> tokens = tokenize(contents);
+    SourceBuffer contents(argv[1]);
+
+    std::vector<Token> tokens;
+    if (contents.size() >= parallel_tokenize_threshold && ThreadPool::default_threads() > 1) {
+        ThreadPool pool;
+        tokens = tokenize_parallel(contents.view(), pool);
+    } else {
+        tokens = tokenize(contents.view());
+    }
 
     std::cout << token_to_asm(tokens) << std::endl;
 
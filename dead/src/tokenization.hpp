@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "keywords.hpp"
+#include "parallel_lex.hpp"
+#include "scan.hpp"
+#include "stream_buffer.hpp"
+
+enum class TokenType {
+    _return,
+    int_lit,
+    semi
+};
+
+// value points into the source buffer, which must outlive the tokens.
+struct Token {
+    TokenType type;
+    std::optional<std::string_view> value {};
+};
+
+inline constexpr auto keywords = lex::make_keywords<TokenType>({
+    {"return", TokenType::_return},
+});
+
+// Thrown by tokenize_chunk; tokenize reports it and exits.
+struct TokenizeError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// End of the token starting at p, which is not whitespace.
+inline const char* token_end(const char* p, const char* end) {
+    if (scan::is_alpha(*p)) return scan::skip_alnum(p + 1, end);
+    if (scan::is_digit(*p)) return scan::skip_digits(p + 1, end);
+    return p + 1;
+}
+
+// Classifies the token [p, e) found by token_end.
+inline Token make_token(const char* p, const char* e) {
+    std::string_view buf(p, e - p);
+    if (scan::is_alpha(*p)) {
+        if (auto kw = keywords.find(buf)) {
+            return {.type = *kw};
+        }
+        throw TokenizeError("Unknown identifier: " + std::string(buf));
+    }
+    if (scan::is_digit(*p)) {
+        return {.type = TokenType::int_lit, .value = buf};
+    }
+    if (*p == ';') {
+        return {.type = TokenType::semi};
+    }
+    throw TokenizeError(std::string("Unexpected character: ") + *p);
+}
+
+inline std::vector<Token> tokenize_chunk(std::string_view str) {
+    std::vector<Token> tokens;
+    const char* end = str.data() + str.size();
+
+    for (const char* p = scan::skip_space(str.data(), end); p < end; p = scan::skip_space(p, end)) {
+        const char* e = token_end(p, end);
+        tokens.push_back(make_token(p, e));
+        p = e;
+    }
+
+    return tokens;
+}
+
+inline std::vector<Token> tokenize(std::string_view str) {
+    try {
+        return tokenize_chunk(str);
+    } catch (const TokenizeError& e) {
+        std::cerr << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Same tokens and diagnostics as tokenize, lexed in chunks on the pool.
+inline std::vector<Token> tokenize_parallel(std::string_view str, ThreadPool& pool) {
+    try {
+        return lex::lex_parallel<Token>(str, pool, tokenize_chunk);
+    } catch (const TokenizeError& e) {
+        std::cerr << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Tokens read from a file descriptor through a fixed-size StreamBuffer, so
+// memory stays constant however long the input is. The value of a returned
+// token is only valid until the next call.
+class StreamTokenizer {
+public:
+    explicit StreamTokenizer(int fd, size_t window = 1 << 16) : m_buf(fd, window) {}
+
+    std::optional<Token> next() {
+        while (true) {
+            const char* p = scan::skip_space(m_buf.begin(), m_buf.end());
+            m_buf.consume(p);
+            if (p == m_buf.end()) {
+                if (m_buf.refill()) continue;
+                return std::nullopt;
+            }
+
+            const char* e = token_end(p, m_buf.end());
+            // A token touching the window edge may continue in unread input.
+            if (e == m_buf.end() && !m_buf.eof()) {
+                if (!m_buf.refill() && m_buf.full()) {
+                    throw TokenizeError("Token longer than the stream window");
+                }
+                continue;
+            }
+            m_buf.consume(e);
+            return make_token(p, e);
+        }
+    }
+
+private:
+    StreamBuffer m_buf;
+};
@@ -1,11 +1,17 @@
+#include <cstdint>
 #include <iostream>
 #include <string>
-#include <cctype>
-#include <memory>
+#include <string_view>
 #include <unordered_map>
 #include <stdexcept>
 #include <vector>
 
+#include "arena.hpp"
+#include "lex_table.hpp"
+#include "node_visit.hpp"
+#include "number.hpp"
+#include "op_table.hpp"
+
 enum class TokenKind {
     End,
     Number,
@@ -17,24 +23,33 @@ enum class TokenKind {
     Invalid
 };
 
+// text views the Lexer's input, which the caller keeps alive.
 struct Token {
     TokenKind kind;
-    std::string text;
+    std::string_view text;
     double number;
 };
 
+static constexpr lex::Dfa kTokenDfa = lex::make_dfa({.underscoreIdent = true, .fractions = true});
+static constexpr lex::PunctTable<TokenKind> kPuncts = lex::make_punct_table<TokenKind>({
+    {'+', TokenKind::Plus},   {'-', TokenKind::Minus},
+    {'*', TokenKind::Star},   {'/', TokenKind::Slash},
+    {'(', TokenKind::LParen}, {')', TokenKind::RParen},
+    {'=', TokenKind::Assign}, {';', TokenKind::Semicolon},
+}, TokenKind::Invalid);
+
 class Lexer {
-    std::string input;
+    std::string_view input;
     size_t pos = 0;
 
     char peekChar() const { return pos < input.size() ? input[pos] : '\0'; }
     char getChar() { return pos < input.size() ? input[pos++] : '\0'; }
 
 public:
-    Lexer(std::string s) : input(std::move(s)) {}
+    Lexer(std::string_view s) : input(s) {}
 
     void skipWS() {
-        while (std::isspace((unsigned char)peekChar())) getChar();
+        pos = scan::skip_space(input.data() + pos, input.data() + input.size()) - input.data();
     }
 
     Token next() {
@@ -42,176 +57,233 @@ public:
         char c = peekChar();
         if (c == '\0') return {TokenKind::End, "", 0.0};
 
-        if (std::isdigit((unsigned char)c)
-            || (c == '.' && pos + 1 < input.size() && std::isdigit((unsigned char)input[pos+1]))) {
-            std::string t;
-        bool seen_dot = false;
-        while (std::isdigit((unsigned char)peekChar()) || (!seen_dot && peekChar() == '.')) {
-            if (peekChar() == '.') seen_dot = true;
-            t.push_back(getChar());
-        }
-        double val = std::stod(t);
-        return {TokenKind::Number, t, val};
-            }
-
-            if (std::isalpha((unsigned char)c) || c == '_') {
-                std::string id;
-                while (std::isalnum((unsigned char)peekChar()) || peekChar() == '_') id.push_back(getChar());
-                return {TokenKind::Identifier, id, 0.0};
+        size_t start = pos;
+        lex::Match m = lex::match(kTokenDfa, input.data() + pos, input.data() + input.size());
+        if (m.shape != lex::Shape::None) {
+            pos = m.end - input.data();
+            std::string_view t = input.substr(start, pos - start);
+            if (m.shape == lex::Shape::Number) {
+                double val = 0.0;
+                if (!lex::parse_number(t, val)) throw std::runtime_error("Number out of range: " + std::string(t));
+                return {TokenKind::Number, t, val};
             }
+            return {TokenKind::Identifier, t, 0.0};
+        }
 
-            char ch = getChar();
-            switch (ch) {
-                case '+': return {TokenKind::Plus, "+", 0};
-                case '-': return {TokenKind::Minus, "-", 0};
-                case '*': return {TokenKind::Star, "*", 0};
-                case '/': return {TokenKind::Slash, "/", 0};
-                case '(': return {TokenKind::LParen, "(", 0};
-                case ')': return {TokenKind::RParen, ")", 0};
-                case '=': return {TokenKind::Assign, "=", 0};
-                case ';': return {TokenKind::Semicolon, ";", 0};
-                default:
-                    return {TokenKind::Invalid, std::string(1, ch), 0};
-            }
+        char ch = getChar();
+        return {kPuncts[(unsigned char)ch], input.substr(pos - 1, 1), 0};
     }
 };
 
-struct Expr { virtual ~Expr() = default; };
+// Nodes are allocated from an Arena and released with it.
+enum class ExprKind : uint8_t { Number, Variable, Binary, Assign };
+
+struct Expr {
+    const ExprKind kind;
+    explicit Expr(ExprKind k) : kind(k) {}
+    virtual ~Expr() = default;
+};
 
 struct NumberExpr : Expr {
     double value;
-    NumberExpr(double v) : value(v) {}
+    NumberExpr(double v) : Expr(ExprKind::Number), value(v) {}
 };
 
 struct VariableExpr : Expr {
-    std::string name;
-    VariableExpr(std::string n) : name(std::move(n)) {}
+    std::string_view name;
+    VariableExpr(std::string_view n) : Expr(ExprKind::Variable), name(n) {}
 };
 
 struct BinaryExpr : Expr {
     char op;
-    std::unique_ptr<Expr> lhs, rhs;
-    BinaryExpr(char o, std::unique_ptr<Expr> l, std::unique_ptr<Expr> r)
-    : op(o), lhs(std::move(l)), rhs(std::move(r)) {}
+    Expr *lhs, *rhs;
+    BinaryExpr(char o, Expr *l, Expr *r) : Expr(ExprKind::Binary), op(o), lhs(l), rhs(r) {}
 };
 
 struct AssignExpr : Expr {
-    std::string name;
-    std::unique_ptr<Expr> value;
-    AssignExpr(std::string n, std::unique_ptr<Expr> v) : name(std::move(n)), value(std::move(v)) {}
+    std::string_view name;
+    Expr *value;
+    AssignExpr(std::string_view n, Expr *v) : Expr(ExprKind::Assign), name(n), value(v) {}
 };
 
+// The node types in ExprKind order, for the passes' lambdas (see
+// node_visit.hpp).
+template <class F>
+decltype(auto) visitExpr(const Expr &e, F &&f) {
+    return ast::visit_kind<NumberExpr, VariableExpr, BinaryExpr, AssignExpr>(e, f);
+}
+
+static constexpr auto kOps = parse::make_op_table<TokenKind>({
+    {TokenKind::Plus, '+', 1}, {TokenKind::Minus, '-', 1},
+    {TokenKind::Star, '*', 2}, {TokenKind::Slash, '/', 2},
+});
+
 class Parser {
     Lexer lex;
+    Arena &arena;
     Token cur;
 
     void consume() { cur = lex.next(); }
 
 public:
-    Parser(const std::string &s) : lex(s) { consume(); }
+    Parser(std::string_view s, Arena &a) : lex(s), arena(a) { consume(); }
 
-    std::unique_ptr<Expr> parsePrimary() {
-        if (cur.kind == TokenKind::Number) {
-            double v = cur.number;
-            consume();
-            return std::make_unique<NumberExpr>(v);
-        }
-        if (cur.kind == TokenKind::Identifier) {
-            std::string id = cur.text;
-            consume();
-            if (cur.kind == TokenKind::Assign) {
+    // Expressions are parsed with explicit operand/operator stacks instead
+    // of recursion, so nesting depth is limited by memory, not the C stack.
+    // Binary operators reduce by kOps binding power (see op_table.hpp); a
+    // pending 'name =' takes everything up to the enclosing ')' or the end.
+    Expr *parseExpression() {
+        ops.clear();
+        vals.clear();
+        size_t open = 0;  // '(' on ops
+        while (true) {
+            // Operand, after any '(' and 'name =' prefixes.
+            if (cur.kind == TokenKind::LParen) {
                 consume();
-                auto rhs = parseExpression();
-                return std::make_unique<AssignExpr>(id, std::move(rhs));
+                ops.push_back({Pending::Paren});
+                ++open;
+                continue;
             }
-            return std::make_unique<VariableExpr>(id);
-        }
-        if (cur.kind == TokenKind::LParen) {
-            consume();
-            auto e = parseExpression();
-            if (cur.kind != TokenKind::RParen) throw std::runtime_error("Expected ')'");
+            if (cur.kind == TokenKind::Number) {
+                vals.push_back(arena.make<NumberExpr>(cur.number));
+                consume();
+            } else if (cur.kind == TokenKind::Identifier) {
+                std::string_view id = cur.text;
+                consume();
+                if (cur.kind == TokenKind::Assign) {
+                    consume();
+                    ops.push_back({Pending::Assign, {}, id});
+                    continue;
+                }
+                vals.push_back(arena.make<VariableExpr>(id));
+            } else {
+                throw std::runtime_error("Unexpected token in primary");
+            }
+
+            // Operator, after any ')' closing groups.
+            while (open > 0 && cur.kind == TokenKind::RParen) {
+                reduceGroup();
+                ops.pop_back();  // the '('
+                --open;
+                consume();
+            }
+            parse::Infix op = kOps[cur.kind];
+            if (op.lbp == 0) break;
+            while (!ops.empty() && ops.back().kind == Pending::Binary && ops.back().infix.rbp >= op.lbp) reduce();
+            ops.push_back({Pending::Binary, op});
             consume();
-            return e;
         }
-        throw std::runtime_error("Unexpected token in primary");
+        if (open > 0) throw std::runtime_error("Expected ')'");
+        reduceGroup();
+        return vals.back();
     }
 
-    std::unique_ptr<Expr> parseTerm() {
-        auto left = parsePrimary();
-        while (cur.kind == TokenKind::Star || cur.kind == TokenKind::Slash) {
-            char op = (cur.kind == TokenKind::Star) ? '*' : '/';
-            consume();
-            auto right = parsePrimary();
-            left = std::make_unique<BinaryExpr>(op, std::move(left), std::move(right));
+private:
+    struct Pending {
+        enum Kind { Paren, Assign, Binary } kind;
+        parse::Infix infix {};   // Binary
+        std::string_view name {}; // Assign
+    };
+    std::vector<Pending> ops;
+    std::vector<Expr*> vals;
+
+    void reduce() {
+        Pending p = ops.back();
+        ops.pop_back();
+        if (p.kind == Pending::Assign) {
+            vals.back() = arena.make<AssignExpr>(p.name, vals.back());
+            return;
         }
-        return left;
+        Expr *rhs = vals.back();
+        vals.pop_back();
+        vals.back() = arena.make<BinaryExpr>(p.infix.op, vals.back(), rhs);
     }
 
-    std::unique_ptr<Expr> parseExpression() {
-        auto left = parseTerm();
-        while (cur.kind == TokenKind::Plus || cur.kind == TokenKind::Minus) {
-            char op = (cur.kind == TokenKind::Plus) ? '+' : '-';
-            consume();
-            auto right = parseTerm();
-            left = std::make_unique<BinaryExpr>(op, std::move(left), std::move(right));
-        }
-        return left;
+    // Reduces everything pending above the innermost '('.
+    void reduceGroup() {
+        while (!ops.empty() && ops.back().kind != Pending::Paren) reduce();
     }
 };
 
-double evalAST(const Expr* node, std::unordered_map<std::string,double> &vars) {
-    if (const NumberExpr* n = dynamic_cast<const NumberExpr*>(node)) {
-        return n->value;
-    }
-    if (const VariableExpr* v = dynamic_cast<const VariableExpr*>(node)) {
-        auto it = vars.find(v->name);
-        if (it == vars.end()) throw std::runtime_error("Undefined variable: " + v->name);
-        return it->second;
-    }
-    if (const BinaryExpr* b = dynamic_cast<const BinaryExpr*>(node)) {
-        double a = evalAST(b->lhs.get(), vars);
-        double c = evalAST(b->rhs.get(), vars);
-        switch (b->op) {
-            case '+': return a + c;
-            case '-': return a - c;
-            case '*': return a * c;
-            case '/': if (c == 0) throw std::runtime_error("Division by zero"); return a / c;
-            default: throw std::runtime_error("Unknown binary op");
+// Calls visit(e) for every node under root, children first and left to
+// right, keeping the walk's stack on the heap rather than the C stack.
+template <class F>
+void walkPostorder(const Expr* root, F&& visit) {
+    struct Frame { const Expr* e; bool expanded; };
+    std::vector<Frame> stack{{root, false}};
+    while (!stack.empty()) {
+        auto [e, expanded] = stack.back();
+        if (expanded) {
+            stack.pop_back();
+            visit(e);
+            continue;
         }
+        stack.back().expanded = true;
+        visitExpr(*e, ast::Overloaded{
+            [&](const BinaryExpr& b) {
+                stack.push_back({b.rhs, false});
+                stack.push_back({b.lhs, false});
+            },
+            [&](const AssignExpr& a) { stack.push_back({a.value, false}); },
+            [](const auto&) {},
+        });
     }
-    if (const AssignExpr* asg = dynamic_cast<const AssignExpr*>(node)) {
-        double val = evalAST(asg->value.get(), vars);
-        vars[asg->name] = val;
-        return val;
-    }
-    throw std::runtime_error("Unknown AST node in eval");
 }
 
-void printAST(const Expr* node, int indent=0) {
+double evalAST(const Expr* root, std::unordered_map<std::string,double> &vars) {
+    std::vector<double> values;
+    walkPostorder(root, [&](const Expr* node) {
+        visitExpr(*node, ast::Overloaded{
+            [&](const NumberExpr& n) { values.push_back(n.value); },
+            [&](const VariableExpr& v) {
+                auto it = vars.find(std::string(v.name));
+                if (it == vars.end()) throw std::runtime_error("Undefined variable: " + std::string(v.name));
+                values.push_back(it->second);
+            },
+            [&](const BinaryExpr& b) {
+                double c = values.back(); values.pop_back();
+                double a = values.back();
+                switch (b.op) {
+                    case '+': values.back() = a + c; return;
+                    case '-': values.back() = a - c; return;
+                    case '*': values.back() = a * c; return;
+                    case '/': if (c == 0) throw std::runtime_error("Division by zero"); values.back() = a / c; return;
+                    default: throw std::runtime_error("Unknown binary op");
+                }
+            },
+            [&](const AssignExpr& asg) { vars[std::string(asg.name)] = values.back(); },
+        });
+    });
+    return values.back();
+}
+
+void printAST(const Expr* root, int indent=0) {
     auto pad = [&](int n){ for(int i=0;i<n;i++) std::cout << ' '; };
-    if (const NumberExpr* n = dynamic_cast<const NumberExpr*>(node)) {
-        pad(indent); std::cout << "Number(" << n->value << ")\n"; return;
-    }
-    if (const VariableExpr* v = dynamic_cast<const VariableExpr*>(node)) {
-        pad(indent); std::cout << "Var(" << v->name << ")\n"; return;
-    }
-    if (const BinaryExpr* b = dynamic_cast<const BinaryExpr*>(node)) {
-        pad(indent); std::cout << "BinaryOp(" << b->op << ")\n";
-        printAST(b->lhs.get(), indent + 2);
-        printAST(b->rhs.get(), indent + 2);
-        return;
-    }
-    if (const AssignExpr* a = dynamic_cast<const AssignExpr*>(node)) {
-        pad(indent); std::cout << "Assign(" << a->name << ")\n";
-        printAST(a->value.get(), indent + 2);
-        return;
+    std::vector<std::pair<const Expr*, int>> stack{{root, indent}};  // children pushed right to left
+    while (!stack.empty()) {
+        auto [node, ind] = stack.back();
+        stack.pop_back();
+        pad(ind);
+        visitExpr(*node, ast::Overloaded{
+            [&](const NumberExpr& n) { std::cout << "Number(" << n.value << ")\n"; },
+            [&](const VariableExpr& v) { std::cout << "Var(" << v.name << ")\n"; },
+            [&](const BinaryExpr& b) {
+                std::cout << "BinaryOp(" << b.op << ")\n";
+                stack.push_back({b.rhs, ind + 2});
+                stack.push_back({b.lhs, ind + 2});
+            },
+            [&](const AssignExpr& a) {
+                std::cout << "Assign(" << a.name << ")\n";
+                stack.push_back({a.value, ind + 2});
+            },
+        });
     }
-    pad(indent); std::cout << "UnknownNode\n";
 }
 
 int main() {
     std::unordered_map<std::string,double> vars;
     std::string line;
+    Arena arena;
 
     std::cout << "AST Compiler. Type expressions or assignments. Empty line to quit.\n";
     while (true) {
@@ -220,12 +292,13 @@ int main() {
         if (line.empty()) break;
 
         try {
-            Parser p(line);
+            arena.reset();
+            Parser p(line, arena);
             auto tree = p.parseExpression();
             std::cout << "[AST]\n";
-            printAST(tree.get(), 2);
+            printAST(tree, 2);
 
-            double result = evalAST(tree.get(), vars);
+            double result = evalAST(tree, vars);
             std::cout << "=> " << result << "\n";
         } catch (const std::exception &e) {
             std::cout << "Error: " << e.what() << "\n";
@@ -0,0 +1,66 @@
+// Parse throughput in AST nodes/sec with every node a separate make_unique
+// (legacy::heap) against the Arena-backed Parser. Each round parses the
+// whole token stream and then releases the tree, so the numbers include
+// the per-node frees the arena replaces with one reset().
+//
+// Usage: ast_alloc_bench [statements] [rounds]   (default 200000, 10)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+namespace {
+
+size_t countNodes(const Expr *e) {
+    size_t n = 0;
+    walkPostorder(e, [&](const Expr*) { ++n; });
+    return n;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 10;
+
+    string src;
+    for (size_t i = 0; i < statements; i += 2) {
+        src += "value_" + to_string(i % 977) + " = (" + to_string(i) + ".5 + rate) * -3 - base / 2;\n";
+        src += "print value_" + to_string(i % 977) + " * (1 + 2 * (3 - x));\n";
+    }
+    TokenStream toks = tokenize(src);
+
+    size_t nodes = 0;
+    {
+        Arena arena;
+        for (Expr *s : Parser(toks, arena).parseProgram()) nodes += countNodes(s);
+    }
+    cout << statements << " statements, " << nodes << " nodes per round, " << rounds << " rounds\n";
+
+    volatile size_t sink = 0;
+    auto t0 = bench::Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        legacy::heap::Parser p(toks);
+        auto prog = p.parseProgram();
+        sink = sink + prog.size();
+    }
+    double heapSecs = bench::seconds_since(t0);
+
+    Arena arena;
+    auto t1 = bench::Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        arena.reset();
+        Parser p(toks, arena);
+        auto prog = p.parseProgram();
+        sink = sink + prog.size();
+    }
+    double arenaSecs = bench::seconds_since(t1);
+
+    double total = double(nodes) * rounds;
+    cout << "make_unique per node: " << total / heapSecs / 1e6 << " M nodes/s\n";
+    cout << "Arena:                " << total / arenaSecs / 1e6 << " M nodes/s ("
+         << arena.bytes() / 1024 << " KB of blocks)\n";
+    cout << "speedup: " << heapSecs / arenaSecs << "x\n";
+    return 0;
+}
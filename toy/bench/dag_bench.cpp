@@ -0,0 +1,76 @@
+// AST size and generated code on redundant input, parsed as trees and with
+// hash-consing (HashCons) into a DAG. The input repeats subexpressions
+// within statements, e.g. (a+b)*(a+b), and repeats the same formulas across
+// statements. Both forms must compute the same values.
+//
+// Usage: dag_bench [statements]   (default 100000)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+struct Result {
+    size_t nodes = 0, arenaKB = 0, instrs = 0;
+    double parseSecs = 0;
+    vector<Value> values;
+};
+
+Result run(const TokenStream &toks, HashCons *cons) {
+    Result r;
+    Arena arena;
+    auto t0 = bench::Clock::now();
+    vector<Expr*> prog = Parser(toks, arena, cons).parseProgram();
+    r.parseSecs = bench::seconds_since(t0);
+    r.nodes = arena.allocations();
+    r.arenaKB = arena.bytes() / 1024;
+
+    SemanticAnalyzer sem;
+    sem.analyzeProgram(prog);
+    ConstPool pool;
+    VM vm(pool);
+    vector<Instr> code;
+    for (const Expr *s : prog) {
+        genForStmt(s, pool, code);
+        r.instrs += code.size();
+        r.values.push_back(vm.execSingle(code));
+    }
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 100000;
+
+    static const char *formulas[] = {
+        "(a + b) * (a + b) - (a + b) / c",
+        "((a - c) * (a - c) + (b - c) * (b - c)) / ((a - c) * (a - c) + 1)",
+        "-(x * y) + (x * y) * (x * y) - 2 * (x * y)",
+        "(a + b) * (x * y) + (a + b) / (x * y + 1)",
+    };
+    string src = "a = 3; b = 4; c = 5; x = 1.5; y = 2;\n";
+    for (size_t i = 0; i < statements; ++i) {
+        src += "r" + to_string(i % 50) + " = " + formulas[i % 4] + " + " + to_string(i % 7) + ";\n";
+    }
+    TokenStream toks = tokenize(src);
+
+    Result tree = run(toks, nullptr);
+    HashCons cons;
+    Result dag = run(toks, &cons);
+    if (tree.values != dag.values) {
+        cerr << "DAG results differ from the tree\n";
+        return 1;
+    }
+
+    cout << statements << " statements, " << toks.size() << " tokens\n";
+    cout << "tree: " << tree.nodes << " nodes, " << tree.arenaKB << " KB arena, " << tree.instrs
+         << " instructions, parse " << tree.parseSecs * 1e3 << " ms\n";
+    cout << "DAG:  " << dag.nodes << " nodes, " << dag.arenaKB << " KB arena, " << dag.instrs
+         << " instructions, parse " << dag.parseSecs * 1e3 << " ms (" << cons.size()
+         << " table entries, " << cons.reused() << " nodes reused)\n";
+    cout << "nodes " << double(tree.nodes) / dag.nodes << "x fewer, instructions "
+         << double(tree.instrs) / dag.instrs << "x fewer\n";
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Per-token branch misses and time of the table-driven lexer against the
+// original isdigit/isalpha chain + switch, on a randomly mixed token stream
+// where the token kind is unpredictable.
+//
+// Usage: dfa_bench [tokens]   (default 4000000)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+namespace {
+
+string makeInput(size_t tokens) {
+    static const char* ops[] = {"+", "-", "*", "/", "(", ")", "=", ";"};
+    mt19937 rng(42);
+    string src;
+    bool word = false;  // last token was a number or identifier
+    for (size_t i = 0; i < tokens; ++i) {
+        string tok;
+        bool isWord = true;
+        switch (rng() % 4) {
+            case 0: tok = "v" + to_string(rng() % 1000); break;
+            case 1: tok = to_string(rng() % 100000); break;
+            case 2: tok = to_string(rng() % 1000) + "." + to_string(rng() % 100); break;
+            default: tok = ops[rng() % 8]; isWord = false; break;
+        }
+        // Run together, two of them would lex as one (and digits overflow).
+        if (word && isWord && src.back() != ' ') src += ' ';
+        src += tok;
+        word = isWord;
+        src += (rng() % 3) ? " " : "";
+    }
+    return src;
+}
+
+// Classification only: how far each token reaches and its kind, with no
+// Token construction, so the counters isolate the decision logic.
+size_t classifyLegacy(const string& in) {
+    size_t pos = 0, sum = 0;
+    while (pos < in.size()) {
+        unsigned char c = in[pos];
+        if (isspace(c)) { pos++; continue; }
+        TokenKind k;
+        if (isdigit(c) || (c == '.' && pos + 1 < in.size() && isdigit((unsigned char)in[pos+1]))) {
+            bool seen_dot = false;
+            while (pos < in.size() && (isdigit((unsigned char)in[pos]) || (!seen_dot && in[pos] == '.'))) {
+                if (in[pos] == '.') seen_dot = true;
+                pos++;
+            }
+            k = TokenKind::Number;
+        } else if (isalpha(c) || c == '_') {
+            while (pos < in.size() && (isalnum((unsigned char)in[pos]) || in[pos] == '_')) pos++;
+            k = TokenKind::Identifier;
+        } else {
+            switch (in[pos++]) {
+                case '+': k = TokenKind::Plus; break;
+                case '-': k = TokenKind::Minus; break;
+                case '*': k = TokenKind::Star; break;
+                case '/': k = TokenKind::Slash; break;
+                case '(': k = TokenKind::LParen; break;
+                case ')': k = TokenKind::RParen; break;
+                case '=': k = TokenKind::Assign; break;
+                case ';': k = TokenKind::Semicolon; break;
+                default: k = TokenKind::Invalid; break;
+            }
+        }
+        sum += size_t(k);
+    }
+    return sum;
+}
+
+size_t classifyTable(const string& in) {
+    const char* p = in.data();
+    const char* end = p + in.size();
+    size_t sum = 0;
+    while (true) {
+        p = scan::skip_space(p, end);
+        if (p == end) break;
+        lex::Match m = lex::match(kTokenDfa, p, end);
+        TokenKind k;
+        if (m.shape == lex::Shape::None) {
+            k = kPuncts[(unsigned char)*p++];
+        } else {
+            k = m.shape == lex::Shape::Number ? TokenKind::Number : TokenKind::Identifier;
+            p = m.end;
+        }
+        sum += size_t(k);
+    }
+    return sum;
+}
+
+struct Sample {
+    double ns;
+    uint64_t misses, branches;
+};
+
+template <class F>
+Sample measure(size_t tokens, F&& f) {
+    bench::PerfCounter misses(PERF_COUNT_HW_BRANCH_MISSES);
+    bench::PerfCounter branches(PERF_COUNT_HW_BRANCH_INSTRUCTIONS);
+    auto t0 = bench::Clock::now();
+    misses.start();
+    branches.start();
+    f();
+    uint64_t b = branches.stop();
+    uint64_t m = misses.stop();
+    return {bench::seconds_since(t0) * 1e9 / tokens, m, b};
+}
+
+void report(const char* name, size_t tokens, const Sample& s, bool perf) {
+    cout << name << s.ns << " ns/token";
+    if (perf) {
+        cout << ", " << double(s.misses) / tokens << " branch misses/token, "
+             << double(s.branches) / tokens << " branches/token";
+    }
+    cout << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t tokens = argc > 1 ? stoul(argv[1]) : 4000000;
+    string src = makeInput(tokens);
+    bool perf = bench::PerfCounter(PERF_COUNT_HW_BRANCH_MISSES).available();
+    if (!perf) cout << "perf events unavailable; reporting time only\n";
+
+    volatile size_t sink = 0;
+    Sample a = measure(tokens, [&] { sink = sink + classifyLegacy(src); });
+    Sample b = measure(tokens, [&] { sink = sink + classifyTable(src); });
+    report("classify, <cctype> chain + switch: ", tokens, a, perf);
+    report("classify, class table + DFA:       ", tokens, b, perf);
+
+    Sample c = measure(tokens, [&] {
+        legacy::Lexer lx(src);
+        while (lx.next().kind != TokenKind::End) {}
+    });
+    Sample d = measure(tokens, [&] {
+        Lexer lx(src);
+        while (lx.next().kind != TokenKind::End) {}
+    });
+    report("Lexer::next, legacy:               ", tokens, c, perf);
+    report("Lexer::next, table-driven:         ", tokens, d, perf);
+    return 0;
+}
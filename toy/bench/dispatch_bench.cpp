@@ -0,0 +1,93 @@
+// Node-type dispatch in each AST pass: the dynamic_cast chains from before
+// ExprKind (legacy::rtti) against visitExpr's dispatch on the kind tag, on the
+// same large tree. Walk is walkPostorder alone (child dispatch); analyze and
+// codegen add the per-node dispatch of SemanticAnalyzer and genForStmt.
+//
+// Usage: dispatch_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+namespace {
+
+// Best of several alternating trials.
+template <class F>
+void measure(double &best, F &&f) {
+    auto t0 = bench::Clock::now();
+    f();
+    best = min(best, bench::seconds_since(t0));
+}
+
+void report(const char *pass, size_t nodes, double rtti, double tag) {
+    cout << pass << ": dynamic_cast " << rtti * 1e9 / nodes << " ns/node, kind tag " << tag * 1e9 / nodes
+         << " ns/node, speedup " << rtti / tag << "x\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    // Prints last in the old chains, so they are the worst case there.
+    string src;
+    for (size_t i = 0; i < statements; i += 2) {
+        src += "value_" + to_string(i % 977) + " = (" + to_string(i) + ".5 + rate) * -3 - base / 2;\n";
+        src += "print value_" + to_string(i % 977) + " * (1 + 2 * (3 - x));\n";
+    }
+    TokenStream toks = tokenize(src);
+    Arena arena;
+    vector<Expr*> prog = Parser(toks, arena).parseProgram();
+
+    size_t nodes = 0;
+    for (const Expr *s : prog) walkPostorder(s, [&](const Expr*) { ++nodes; });
+    cout << prog.size() << " statements, " << nodes << " nodes\n";
+
+    double walkRtti = 1e30, walkTag = 1e30, semRtti = 1e30, semTag = 1e30, genRtti = 1e30, genTag = 1e30;
+    SemanticAnalyzer sem;
+    vector<Diagnostic> warnings;
+    ConstPool pool;
+    vector<Instr> code;
+    volatile size_t sink = 0;
+    for (int r = 0; r < rounds; ++r) {
+        measure(walkRtti, [&] {
+            size_t n = 0;
+            for (const Expr *s : prog) legacy::rtti::walkPostorder(s, [&](const Expr*) { ++n; });
+            sink = sink + n;
+        });
+        measure(walkTag, [&] {
+            size_t n = 0;
+            for (const Expr *s : prog) walkPostorder(s, [&](const Expr*) { ++n; });
+            sink = sink + n;
+        });
+        measure(semRtti, [&] { sink = sink + legacy::rtti::analyze(prog, warnings); });
+        measure(semTag, [&] { sem.analyzeProgram(prog); });
+        measure(genRtti, [&] {
+            for (const Expr *s : prog) legacy::rtti::genForStmt(s, pool, code);
+        });
+        measure(genTag, [&] {
+            for (const Expr *s : prog) genForStmt(s, pool, code);
+        });
+    }
+
+    // Same diagnostics and the same code.
+    bool same = warnings.size() == sem.getWarnings().size();
+    vector<Instr> old;
+    for (size_t i = 0; same && i < prog.size(); ++i) {
+        legacy::rtti::genForStmt(prog[i], pool, old);
+        genForStmt(prog[i], pool, code);
+        same = old.size() == code.size();
+        for (size_t j = 0; same && j < code.size(); ++j) same = old[j].op == code[j].op && old[j].arg == code[j].arg;
+    }
+    if (!same) {
+        cerr << "tag dispatch differs from the dynamic_cast passes\n";
+        return 1;
+    }
+
+    report("walk   ", nodes, walkRtti, walkTag);
+    report("analyze", nodes, semRtti, semTag);
+    report("codegen", nodes, genRtti, genTag);
+    return 0;
+}
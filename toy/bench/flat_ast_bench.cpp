@@ -0,0 +1,123 @@
+// Pass times over the Arena pointer tree (walkPostorder + dynamic_cast)
+// against the same program as a post-order FlatAst iterated front to back:
+// semantic analysis, code generation, and evaluation (CodeGen + VM for the
+// tree, FlatEvaluator for the array). Cache misses are reported where perf
+// events are permitted. Both sides must produce the same code and results.
+//
+// Usage: flat_ast_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+struct Sample {
+    double secs = 1e30;
+    uint64_t misses = 0;
+};
+
+// Best of several alternating trials; misses are those of the best trial.
+template <class F>
+void measure(Sample &s, F &&f) {
+    bench::PerfCounter misses(PERF_COUNT_HW_CACHE_MISSES);
+    auto t0 = bench::Clock::now();
+    misses.start();
+    f();
+    uint64_t m = misses.stop();
+    double secs = bench::seconds_since(t0);
+    if (secs < s.secs) s = {secs, m};
+}
+
+void report(const char *pass, size_t nodes, const Sample &tree, const Sample &flat, bool perf) {
+    cout << pass << ": tree " << tree.secs * 1e9 / nodes << " ns/node, flat " << flat.secs * 1e9 / nodes
+         << " ns/node, speedup " << tree.secs / flat.secs << "x";
+    if (perf) {
+        cout << "; cache misses/node " << double(tree.misses) / nodes << " -> " << double(flat.misses) / nodes;
+    }
+    cout << "\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    string src = "rate = 1.5; base = 4; x = 2;\n";
+    for (size_t i = 0; i < statements; i += 2) {
+        src += "value_" + to_string(i % 977) + " = (" + to_string(i) + ".5 + rate) * -3 - base / 2;\n";
+        src += "print value_" + to_string(i % 977) + " * (1 + 2 * (3 - x));\n";
+    }
+    TokenStream toks = tokenize(src);
+    Arena arena;
+    vector<Expr*> prog = Parser(toks, arena).parseProgram();
+    SemanticAnalyzer sem;
+    sem.analyzeProgram(prog);  // types the nodes flatten copies
+    FlatAst flat = flatten(prog);
+    size_t nodes = flat.nodes.size();
+
+    bool perf = bench::PerfCounter(PERF_COUNT_HW_CACHE_MISSES).available();
+    if (!perf) cout << "perf events unavailable; reporting time only\n";
+    cout << prog.size() << " statements, " << nodes << " nodes: tree " << arena.bytes() / 1024
+         << " KB of arena blocks, flat " << flat.bytes() / 1024 << " KB\n";
+
+    // Print statements would flood the terminal; the stream drops output
+    // while it has no buffer, at the same cost for both sides.
+    streambuf *out = cout.rdbuf(nullptr);
+
+    Sample semTree, semFlat, genTree, genFlat, evalTree, evalFlat;
+    ConstPool pool;
+    vector<Instr> code;
+    volatile uint64_t sink = 0;
+    for (int r = 0; r < rounds; ++r) {
+        measure(semTree, [&] { sem.analyzeProgram(prog); });
+        measure(semFlat, [&] { sem.analyzeProgram(flat); });
+        measure(genTree, [&] {
+            for (const Expr *s : prog) genForStmt(s, pool, code);
+        });
+        measure(genFlat, [&] {
+            for (size_t i = 0; i < flat.statements(); ++i) genForStmt(flat, i, pool, code);
+        });
+        measure(evalTree, [&] {
+            VM vm(pool);
+            for (const Expr *s : prog) {
+                genForStmt(s, pool, code);
+                sink = sink + vm.execSingle(code).bits;
+            }
+        });
+        measure(evalFlat, [&] {
+            FlatEvaluator ev;
+            for (size_t i = 0; i < flat.statements(); ++i) sink = sink + ev.run(flat, i).bits;
+        });
+    }
+    cout.rdbuf(out);
+    cout.clear();
+
+    // Same code and the same result for every statement.
+    VM vm(pool);
+    FlatEvaluator ev;
+    vector<Instr> flatCode;
+    cout.rdbuf(nullptr);
+    bool same = true;
+    for (size_t i = 0; same && i < prog.size(); ++i) {
+        genForStmt(prog[i], pool, code);
+        genForStmt(flat, i, pool, flatCode);
+        same = code.size() == flatCode.size();
+        for (size_t j = 0; same && j < code.size(); ++j) {
+            same = code[j].op == flatCode[j].op && code[j].arg == flatCode[j].arg;
+        }
+        same = same && vm.execSingle(code) == ev.run(flat, i);
+    }
+    cout.rdbuf(out);
+    cout.clear();
+    if (!same) {
+        cerr << "flat AST differs from the tree\n";
+        return 1;
+    }
+
+    report("analyze ", nodes, semTree, semFlat, perf);
+    report("codegen ", nodes, genTree, genFlat, perf);
+    report("evaluate", nodes, evalTree, evalFlat, perf);
+    return 0;
+}
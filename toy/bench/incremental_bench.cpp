@@ -0,0 +1,104 @@
+// Cost of one single-character edit to a large program: IncrementalFrontend,
+// which relexes and reparses only the statements the edit touches, against
+// tokenizing and parsing the whole text again. Edits replace a digit, insert
+// or delete a space, and delete or restore a ';' (which merges two
+// statements into one that fails to parse, then splits them again). At the
+// end both front ends must produce the same code for every statement.
+//
+// Usage: incremental_bench [statements] [edits]   (default 100000, 3000)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 100000;
+    size_t edits = argc > 2 ? stoul(argv[2]) : 3000;
+
+    string src;
+    for (size_t i = 0; i < statements; ++i) {
+        if (i % 4 == 3) src += "print v" + to_string(i % 100) + " * 2;\n";
+        else src += "v" + to_string(i % 100) + " = (" + to_string(i) + " + x) * -3 - y / 2;\n";
+    }
+
+    // Full front end per edit.
+    int fullRuns = 10;
+    Arena arena;
+    size_t fullStmts = 0;
+    auto t0 = bench::Clock::now();
+    for (int r = 0; r < fullRuns; ++r) {
+        arena.reset();
+        TokenStream toks = tokenize(src);
+        fullStmts = Parser(toks, arena).parseProgram().size();
+    }
+    double fullSecs = bench::seconds_since(t0) / fullRuns;
+
+    auto b0 = bench::Clock::now();
+    IncrementalFrontend doc(src);
+    double buildSecs = bench::seconds_since(b0);
+
+    // Each edit is applied to both `src` and `doc`. A deleted space or ';'
+    // is restored by the next edit.
+    mt19937 rng(11);
+    size_t relexed = 0;
+    double editSecs = 0;
+    size_t pendingSpace = string::npos, pendingSemi = string::npos;
+    auto apply = [&](size_t begin, size_t end, string_view text) {
+        src.replace(begin, end - begin, text);
+        auto t = bench::Clock::now();
+        doc.edit(begin, end, text);
+        editSecs += bench::seconds_since(t);
+        relexed += doc.relexedByLastEdit();
+    };
+    for (size_t k = 0; k < edits; ++k) {
+        if (pendingSpace != string::npos) {
+            apply(pendingSpace, pendingSpace + 1, "");
+            pendingSpace = string::npos;
+        } else if (pendingSemi != string::npos) {
+            apply(pendingSemi, pendingSemi, ";");
+            pendingSemi = string::npos;
+        } else {
+            size_t p = rng() % src.size();
+            if (isdigit((unsigned char)src[p])) {
+                apply(p, p + 1, string(1, char('0' + rng() % 9 + 1)));
+            } else if (k % 5 == 0 && src.find(';', p) != string::npos) {
+                pendingSemi = src.find(';', p);
+                apply(pendingSemi, pendingSemi + 1, "");
+            } else {
+                apply(p, p, " ");
+                pendingSpace = p;
+            }
+        }
+    }
+    editSecs /= edits;
+
+    // Same statements and code as a full parse of the edited text.
+    if (doc.text() != src) {
+        cerr << "incremental text differs from the edited source\n";
+        return 1;
+    }
+    arena.reset();
+    TokenStream toks = tokenize(src);
+    auto full = Parser(toks, arena).parseProgram();
+    auto incr = doc.program();
+    ConstPool pool;
+    bool same = full.size() == incr.size() && !doc.firstError();
+    for (size_t i = 0; same && i < full.size(); ++i) {
+        auto a = genForStmt(full[i], pool), b = genForStmt(incr[i], pool);
+        same = a.size() == b.size();
+        for (size_t j = 0; same && j < a.size(); ++j) {
+            same = a[j].op == b[j].op && a[j].arg == b[j].arg;
+        }
+    }
+    if (!same) {
+        cerr << "incremental program differs from a full parse\n";
+        return 1;
+    }
+
+    cout << statements << " statements, " << src.size() / 1024 << " KB\n";
+    cout << "full tokenize + parse: " << fullSecs * 1e3 << " ms per edit (" << fullStmts << " statements)\n";
+    cout << "incremental: initial build " << buildSecs * 1e3 << " ms, then " << editSecs * 1e6
+         << " us per edit, " << double(relexed) / edits << " statements relexed per edit\n";
+    cout << "speedup per edit: " << fullSecs / editSecs << "x\n";
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Stack code straight from the trees (CodeGen) against stack code through
+// the IR and its passes (fold, cse, dce) for the same statements, written
+// as people write them: constants spelled as products, a subexpression
+// repeated instead of named. Reports the instructions each emits, what
+// compiling costs per statement and VM time per statement; both must
+// compute the same results.
+//
+// Usage: ir_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+// Statements are compiled and run a block at a time, as the drivers run
+// code soon after generating it.
+constexpr size_t kBlock = 256;
+
+struct Totals {
+    double treeCompile = 0, irCompile = 0, treeRun = 0, irRun = 0;
+    size_t treeInstrs = 0, irInstrs = 0;
+    vector<Value> treeResults, irResults;
+};
+
+Totals runBlocks(const vector<Expr*> &prog) {
+    Totals t;
+    t.treeResults.reserve(prog.size());
+    t.irResults.reserve(prog.size());
+    ConstPool pool;
+    VM treeVm(pool), irVm(pool);
+    vector<vector<Instr>> treeCode(kBlock), irCode(kBlock);
+    const ir::PassManager &passes = ir::PassManager::standard();
+    for (size_t first = 0; first < prog.size(); first += kBlock) {
+        size_t n = min(kBlock, prog.size() - first);
+        auto t0 = bench::Clock::now();
+        for (size_t i = 0; i < n; ++i) genForStmt(prog[first + i], pool, treeCode[i]);
+        t.treeCompile += bench::seconds_since(t0);
+        t0 = bench::Clock::now();
+        for (size_t i = 0; i < n; ++i) genForStmt(prog[first + i], pool, irCode[i], passes);
+        t.irCompile += bench::seconds_since(t0);
+        for (size_t i = 0; i < n; ++i) {
+            t.treeInstrs += treeCode[i].size();
+            t.irInstrs += irCode[i].size();
+        }
+        auto run = [&](VM &vm, vector<vector<Instr>> &code, vector<Value> &results, double &secs) {
+            auto t0 = bench::Clock::now();
+            for (size_t i = 0; i < n; ++i) results.push_back(vm.execSingle(code[i]));
+            secs += bench::seconds_since(t0);
+        };
+        // Alternately first, as the second finds more of the block cached.
+        if (first / kBlock % 2) {
+            run(treeVm, treeCode, t.treeResults, t.treeRun);
+            run(irVm, irCode, t.irResults, t.irRun);
+        } else {
+            run(irVm, irCode, t.irResults, t.irRun);
+            run(treeVm, treeCode, t.treeResults, t.treeRun);
+        }
+    }
+    return t;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    vector<string> forms = {
+        "secs = days * 24 * 60 * 60 + (n - k) * (n - k)",
+        "n = (n * 7 + k) - n / 1000 * 7000",
+        "x = x * (1.0 - rate) + y * rate * (60 * 60 / 3600)",
+        "k = (k + n * 2) / (n * 2 + 1) + 0",
+        "y = (x + y) * 0.5 + (x + y) * (x + y) / 1000.0",
+    };
+    string src = "n = 5; k = 3; days = 2; x = 1.5; y = 2.5; rate = 0.25;\n";
+    for (size_t i = 0; i < statements; ++i) src += forms[i % forms.size()] + ";\n";
+    TokenStream toks = tokenize(src);
+    Arena arena;
+    vector<Expr*> prog = Parser(toks, arena).parseProgram();
+    SemanticAnalyzer sem;
+    sem.analyzeProgram(prog);
+
+    Totals best = runBlocks(prog);
+    for (int r = 1; r < rounds; ++r) {
+        Totals t = runBlocks(prog);
+        best.treeCompile = min(best.treeCompile, t.treeCompile);
+        best.irCompile = min(best.irCompile, t.irCompile);
+        best.treeRun = min(best.treeRun, t.treeRun);
+        best.irRun = min(best.irRun, t.irRun);
+    }
+    if (best.treeResults != best.irResults) {
+        cerr << "code through the IR computes different results\n";
+        return 1;
+    }
+
+    size_t n = prog.size();
+    cout << n << " statements\n";
+    cout << "  tree: " << double(best.treeInstrs) / n << " instructions/statement, compile "
+         << best.treeCompile * 1e9 / n << " ns, run " << best.treeRun * 1e9 / n << " ns per statement\n";
+    cout << "  IR:   " << double(best.irInstrs) / n << " instructions/statement, compile "
+         << best.irCompile * 1e9 / n << " ns, run " << best.irRun * 1e9 / n << " ns per statement\n";
+    cout << "  instructions " << double(best.treeInstrs) / best.irInstrs << "x fewer, run speedup "
+         << best.treeRun / best.irRun << "x\n";
+    return 0;
+}
@@ -0,0 +1,495 @@
+#pragma once
+
+// Baseline copies of final.cpp components as they were before the
+// optimizations the benchmarks measure. Include after final.cpp.
+
+namespace legacy {
+
+// Token as it was before the struct-of-arrays TokenStream: every token owns
+// a copy of its text.
+struct Token {
+    TokenKind kind;
+    string text;
+    double number = 0.0;
+};
+
+inline bool isKeywordPrint(const string &s) {
+    return s == "print";
+}
+
+// Lexer::next as it was before the scan kernels and DFA tables: one
+// <cctype> call per byte and a switch over the single-char tokens.
+class Lexer {
+    string in;
+    size_t pos = 0;
+public:
+    Lexer(string s): in(move(s)), pos(0) {}
+    char peek() const { return pos < in.size() ? in[pos] : '\0'; }
+    char get() { return pos < in.size() ? in[pos++] : '\0'; }
+    void skipWS() { while (isspace((unsigned char)peek())) get(); }
+
+    Token next() {
+        skipWS();
+        char c = peek();
+        if (c == '\0') return {TokenKind::End, ""};
+        if (isdigit((unsigned char)c) || (c == '.' && pos + 1 < in.size() && isdigit((unsigned char)in[pos+1]))) {
+            string s;
+            bool seen_dot = false;
+            while (isdigit((unsigned char)peek()) || (!seen_dot && peek() == '.')) {
+                if (peek() == '.') seen_dot = true;
+                s.push_back(get());
+            }
+            Token t; t.kind = TokenKind::Number; t.text = s; t.number = stod(s);
+            return t;
+        }
+        if (isalpha((unsigned char)c) || c == '_') {
+            string id;
+            while (isalnum((unsigned char)peek()) || peek() == '_') id.push_back(get());
+            if (isKeywordPrint(id)) return {TokenKind::KeywordPrint, id};
+            return {TokenKind::Identifier, id};
+        }
+        char ch = get();
+        switch (ch) {
+            case '+': return {TokenKind::Plus, "+"};
+            case '-': return {TokenKind::Minus, "-"};
+            case '*': return {TokenKind::Star, "*"};
+            case '/': return {TokenKind::Slash, "/"};
+            case '(': return {TokenKind::LParen, "("};
+            case ')': return {TokenKind::RParen, ")"};
+            case '=': return {TokenKind::Assign, "="};
+            case ';': return {TokenKind::Semicolon, ";"};
+            default: return {TokenKind::Invalid, string(1,ch)};
+        }
+    }
+};
+
+// Arena-backed Parser as it was before the operator table: one recursive
+// function per precedence level.
+class DescentParser {
+    const TokenStream &toks;
+    Arena &arena;
+    size_t pos = 0;
+public:
+    DescentParser(const TokenStream &t, Arena &a): toks(t), arena(a), pos(0) {}
+    TokenKind peek() {
+        if (pos >= toks.size()) throw SourceError(uint32_t(toks.source().size()), "Parser: unexpected end");
+        return toks.kind(pos);
+    }
+    TokenRef get() {
+        if (pos >= toks.size()) throw SourceError(uint32_t(toks.source().size()), "Parser: unexpected end");
+        return {&toks, pos++};
+    }
+    bool accept(TokenKind k) {
+        if (pos < toks.size() && toks.kind(pos) == k) { pos++; return true; }
+        return false;
+    }
+    vector<Expr*> parseProgram() {
+        vector<Expr*> out;
+        while (pos < toks.size() && peek() != TokenKind::End) {
+            auto s = parseStatement();
+            out.push_back(s);
+
+            // Require semicolon after each statement
+            if (!accept(TokenKind::Semicolon) && peek() != TokenKind::End) {
+                throw SourceError(here(), "Parser: expected ';' after statement");
+            }
+
+        }
+        return out;
+    }
+
+
+
+
+private:
+    // Offset of the next token, for errors about what was expected there.
+    uint32_t here() const {
+        return pos < toks.size() ? toks.offset(pos) : uint32_t(toks.source().size());
+    }
+
+    template <class T, class... Args>
+    Expr *node(uint32_t at, Args&&... args) {
+        T *e = arena.make<T>(forward<Args>(args)...);
+        e->pos = at;
+        return e;
+    }
+
+    Expr *parseStatement() {
+        if (pos < toks.size()) {
+            if (peek() == TokenKind::KeywordPrint) {
+                uint32_t at = get().offset(); // consume 'print'
+                // allow: print ( <expr> )  or print <expr>
+                if (accept(TokenKind::LParen)) {
+                    auto e = parseExpression();
+                    if (!accept(TokenKind::RParen)) throw SourceError(here(), "Parser: expected ')'");
+                    return node<PrintExpr>(at, e);
+                } else {
+                    auto e = parseExpression();
+                    return node<PrintExpr>(at, e);
+                }
+            }
+            // assignment: Identifier '=' expression
+            if (peek() == TokenKind::Identifier) {
+                // lookahead
+                TokenRef id{&toks, pos};
+                if (pos + 1 < toks.size() && toks.kind(pos+1) == TokenKind::Assign) {
+                    pos++; // consume id
+                    pos++; // consume =
+                    auto rhs = parseExpression();
+                    return node<AssignExpr>(id.offset(), id.symbol(), rhs);
+                }
+            }
+        }
+        return parseExpression();
+    }
+
+    Expr *parseExpression() {
+        auto left = parseTerm();
+        while (pos < toks.size() && (peek() == TokenKind::Plus || peek() == TokenKind::Minus)) {
+            TokenRef op = get();
+            auto right = parseTerm();
+            left = node<BinaryExpr>(op.offset(), op.text()[0], left, right);
+        }
+        return left;
+    }
+
+    Expr *parseTerm() {
+        auto left = parseFactor();
+        while (pos < toks.size() && (peek() == TokenKind::Star || peek() == TokenKind::Slash)) {
+            TokenRef op = get();
+            auto right = parseFactor();
+            left = node<BinaryExpr>(op.offset(), op.text()[0], left, right);
+        }
+        return left;
+    }
+
+    Expr *parseFactor() {
+        // Support unary minus here
+        if (peek() == TokenKind::Minus) {
+            uint32_t at = get().offset(); // consume '-'
+            auto operand = parseFactor();
+            return node<BinaryExpr>(at, '-', node<NumberExpr>(at, kZero), operand);
+        }
+
+        TokenRef t = get();
+        if (t.kind() == TokenKind::Number) {
+            return node<NumberExpr>(t.offset(), t.number());
+        } else if (t.kind() == TokenKind::Identifier) {
+            return node<VariableExpr>(t.offset(), t.symbol());
+        } else if (t.kind() == TokenKind::LParen) {
+            auto e = parseExpression();
+            if (!accept(TokenKind::RParen)) throw SourceError(here(), "Parser: expected ')'");
+            return e;
+        }
+        throw SourceError(t.offset(), "Parser: unexpected token '" + string(t.text()) + "'");
+    }
+};
+
+// AST and Parser as they were before the Arena: every node is its own
+// make_unique allocation and names are owned std::strings.
+namespace heap {
+
+struct Expr {
+    uint32_t pos = 0;
+    virtual ~Expr() = default;
+};
+
+struct NumberExpr : Expr {
+    Literal value;
+    NumberExpr(Literal v): value(v) {}
+};
+
+struct VariableExpr : Expr {
+    string name;
+    VariableExpr(string n): name(move(n)) {}
+};
+
+struct BinaryExpr : Expr {
+    char op;
+    unique_ptr<Expr> lhs, rhs;
+    BinaryExpr(char o, unique_ptr<Expr> l, unique_ptr<Expr> r): op(o), lhs(move(l)), rhs(move(r)) {}
+};
+
+struct AssignExpr : Expr {
+    string name;
+    unique_ptr<Expr> value;
+    AssignExpr(string n, unique_ptr<Expr> v): name(move(n)), value(move(v)) {}
+};
+
+struct PrintExpr : Expr {
+    unique_ptr<Expr> value;
+    PrintExpr(unique_ptr<Expr> v): value(move(v)) {}
+};
+
+class Parser {
+    const TokenStream &toks;
+    size_t pos = 0;
+public:
+    Parser(const TokenStream &t): toks(t), pos(0) {}
+    TokenKind peek() {
+        if (pos >= toks.size()) throw runtime_error("Parser: unexpected end");
+        return toks.kind(pos);
+    }
+    TokenRef get() {
+        if (pos >= toks.size()) throw runtime_error("Parser: unexpected end");
+        return {&toks, pos++};
+    }
+    bool accept(TokenKind k) {
+        if (pos < toks.size() && toks.kind(pos) == k) { pos++; return true; }
+        return false;
+    }
+    vector<unique_ptr<Expr>> parseProgram() {
+        vector<unique_ptr<Expr>> out;
+        while (pos < toks.size() && peek() != TokenKind::End) {
+            out.push_back(parseStatement());
+            if (!accept(TokenKind::Semicolon) && peek() != TokenKind::End) {
+                throw runtime_error("Parser: expected ';' after statement");
+            }
+        }
+        return out;
+    }
+
+private:
+    template <class T, class... Args>
+    static unique_ptr<Expr> node(uint32_t at, Args&&... args) {
+        auto e = make_unique<T>(forward<Args>(args)...);
+        e->pos = at;
+        return e;
+    }
+
+    unique_ptr<Expr> parseStatement() {
+        if (peek() == TokenKind::KeywordPrint) {
+            uint32_t at = get().offset();
+            if (accept(TokenKind::LParen)) {
+                auto e = parseExpression();
+                if (!accept(TokenKind::RParen)) throw runtime_error("Parser: expected ')'");
+                return node<PrintExpr>(at, move(e));
+            }
+            return node<PrintExpr>(at, parseExpression());
+        }
+        if (peek() == TokenKind::Identifier && pos + 1 < toks.size() && toks.kind(pos+1) == TokenKind::Assign) {
+            TokenRef id = get();
+            pos++;
+            auto rhs = parseExpression();
+            return node<AssignExpr>(id.offset(), string(id.text()), move(rhs));
+        }
+        return parseExpression();
+    }
+
+    unique_ptr<Expr> parseExpression() {
+        auto left = parseTerm();
+        while (pos < toks.size() && (peek() == TokenKind::Plus || peek() == TokenKind::Minus)) {
+            TokenRef op = get();
+            auto right = parseTerm();
+            left = node<BinaryExpr>(op.offset(), op.text()[0], move(left), move(right));
+        }
+        return left;
+    }
+
+    unique_ptr<Expr> parseTerm() {
+        auto left = parseFactor();
+        while (pos < toks.size() && (peek() == TokenKind::Star || peek() == TokenKind::Slash)) {
+            TokenRef op = get();
+            auto right = parseFactor();
+            left = node<BinaryExpr>(op.offset(), op.text()[0], move(left), move(right));
+        }
+        return left;
+    }
+
+    unique_ptr<Expr> parseFactor() {
+        if (peek() == TokenKind::Minus) {
+            uint32_t at = get().offset();
+            auto operand = parseFactor();
+            return node<BinaryExpr>(at, '-', node<NumberExpr>(at, kZero), move(operand));
+        }
+        TokenRef t = get();
+        if (t.kind() == TokenKind::Number) return node<NumberExpr>(t.offset(), t.number());
+        if (t.kind() == TokenKind::Identifier) return node<VariableExpr>(t.offset(), string(t.text()));
+        if (t.kind() == TokenKind::LParen) {
+            auto e = parseExpression();
+            if (!accept(TokenKind::RParen)) throw runtime_error("Parser: expected ')'");
+            return e;
+        }
+        throw runtime_error("Parser: unexpected token '" + string(t.text()) + "'");
+    }
+};
+
+} // namespace heap
+
+// AST passes as they were before ExprKind: each node's type is found by
+// trying dynamic_cast against one node type after another.
+namespace rtti {
+
+template <class F>
+void walkPostorder(const Expr *root, F &&visit) {
+    struct Frame { const Expr *e; bool expanded; };
+    vector<Frame> stack{{root, false}};
+    while (!stack.empty()) {
+        auto [e, expanded] = stack.back();
+        if (!e) { stack.pop_back(); continue; }
+        if (expanded) {
+            stack.pop_back();
+            visit(e);
+            continue;
+        }
+        stack.back().expanded = true;
+        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
+            stack.push_back({b->rhs, false});
+            stack.push_back({b->lhs, false});
+        } else if (auto a = dynamic_cast<const AssignExpr*>(e)) {
+            stack.push_back({a->value, false});
+        } else if (auto pr = dynamic_cast<const PrintExpr*>(e)) {
+            stack.push_back({pr->value, false});
+        }
+    }
+}
+
+// SemanticAnalyzer::analyzeProgram.
+inline size_t analyze(const vector<Expr*> &prog, vector<Diagnostic> &warnings) {
+    vector<char> assigned;
+    warnings.clear();
+    size_t errors = 0;
+    for (const Expr *s : prog) {
+        rtti::walkPostorder(s, [&](const Expr *e) {
+            if (dynamic_cast<const NumberExpr*>(e)) return;
+            if (auto v = dynamic_cast<const VariableExpr*>(e)) {
+                if (v->sym >= assigned.size() || !assigned[v->sym])
+                    warnings.push_back({v->pos, "use of variable '" + string(symbols().name(v->sym)) + "' before assignment"});
+                return;
+            }
+            if (dynamic_cast<const BinaryExpr*>(e)) return;
+            if (auto as = dynamic_cast<const AssignExpr*>(e)) {
+                if (as->sym >= assigned.size()) assigned.resize(symbols().size());
+                assigned[as->sym] = 1;
+                return;
+            }
+            if (dynamic_cast<const PrintExpr*>(e)) return;
+            ++errors;
+        });
+    }
+    return errors;
+}
+
+// genForStmt, without the shared-node temporaries. Needs the node types
+// from SemanticAnalyzer.
+inline void genForStmt(const Expr *stmt, ConstPool &pool, vector<Instr> &out) {
+    out.clear();
+    rtti::walkPostorder(stmt, [&](const Expr *e) {
+        if (auto n = dynamic_cast<const NumberExpr*>(e)) {
+            out.emplace_back(OpCode::PUSH_CONST, pool.intern(n->value));
+            return;
+        }
+        if (auto v = dynamic_cast<const VariableExpr*>(e)) {
+            out.emplace_back(OpCode::LOAD_SLOT, v->sym, v->pos);
+            return;
+        }
+        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
+            emitBinary(b->op, b->lhs->type, b->rhs->type, b->pos, out);
+            return;
+        }
+        if (auto a = dynamic_cast<const AssignExpr*>(e)) {
+            emitStore(a->sym, a->type, a->value->type, out);
+            return;
+        }
+        if (auto p = dynamic_cast<const PrintExpr*>(e)) {
+            emitPrint(p->value->type, out);
+            return;
+        }
+    });
+}
+
+} // namespace rtti
+
+// VM::execSingle's variable access as it was before frame slots, over the
+// same code. Vars is the variable store: ByName as before symbols (a hash
+// map searched by name on every access) or BySymbol as before the flat
+// frame (optional values, grown on store).
+namespace vars {
+
+class ByName {
+    unordered_map<string_view, Value> vars;
+public:
+    optional<Value> get(Symbol sym) const {
+        auto it = vars.find(symbols().name(sym));
+        return it == vars.end() ? nullopt : optional<Value>(it->second);
+    }
+    void set(Symbol sym, Value v) { vars[symbols().name(sym)] = v; }
+};
+
+class BySymbol {
+    vector<optional<Value>> vars;
+public:
+    optional<Value> get(Symbol sym) const { return sym < vars.size() ? vars[sym] : nullopt; }
+    void set(Symbol sym, Value v) {
+        if (sym >= vars.size()) vars.resize(symbols().size());
+        vars[sym] = v;
+    }
+};
+
+template <class Vars>
+class VM {
+    const ConstPool &pool;
+    vector<Value> stack;
+    Vars vars;
+public:
+    explicit VM(const ConstPool &p): pool(p) {}
+
+    // Without printing or the DAG temporaries.
+    Value execSingle(span<const Instr> code) {
+        stack.clear();
+        for (const Instr &ins : code) {
+            switch (ins.op) {
+                case OpCode::PUSH_CONST: stack.push_back(pool[ins.arg]); break;
+                case OpCode::LOAD_SLOT: {
+                    auto v = vars.get(ins.arg);
+                    if (!v) throw SourceError(ins.pos, "VM: undefined variable '" + string(symbols().name(ins.arg)) + "'");
+                    stack.push_back(*v);
+                } break;
+                case OpCode::ISTORE_SLOT:
+                case OpCode::FSTORE_SLOT: {
+                    if (stack.empty()) throw runtime_error("VM: store with empty stack");
+                    Value v = stack.back(); stack.pop_back();
+                    vars.set(ins.arg, v);
+                    stack.push_back(v);
+                } break;
+                case OpCode::IADD: intOp<'+'>(ins.pos); break;
+                case OpCode::ISUB: intOp<'-'>(ins.pos); break;
+                case OpCode::IMUL: intOp<'*'>(ins.pos); break;
+                case OpCode::FADD: floatOp<'+'>(ins.pos); break;
+                case OpCode::FSUB: floatOp<'-'>(ins.pos); break;
+                case OpCode::FMUL: floatOp<'*'>(ins.pos); break;
+                case OpCode::FDIV: floatOp<'/'>(ins.pos); break;
+                case OpCode::I2F:
+                case OpCode::I2F_LHS: {
+                    size_t depth = ins.op == OpCode::I2F ? 1 : 2;
+                    if (stack.size() < depth) throw runtime_error("VM: stack underflow I2F");
+                    Value &v = stack[stack.size() - depth];
+                    v = Value::ofFloat(double(v.i()));
+                } break;
+                default:
+                    throw runtime_error("VM: unknown opcode");
+            }
+        }
+        return stack.empty() ? Value{} : stack.back();
+    }
+
+private:
+    template <char op>
+    void intOp(uint32_t pos) {
+        if (stack.size() < 2) throw runtime_error("VM: stack underflow");
+        int64_t r = stack.back().i(); stack.pop_back();
+        int64_t l = stack.back().i(); stack.pop_back();
+        stack.push_back(Value::ofInt(intArith<op>(l, r, pos)));
+    }
+    template <char op>
+    void floatOp(uint32_t pos) {
+        if (stack.size() < 2) throw runtime_error("VM: stack underflow");
+        double r = stack.back().f(); stack.pop_back();
+        double l = stack.back().f(); stack.pop_back();
+        stack.push_back(Value::ofFloat(floatArith<op>(l, r, pos)));
+    }
+};
+
+} // namespace vars
+
+} // namespace legacy
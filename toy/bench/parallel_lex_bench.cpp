@@ -0,0 +1,72 @@
+// Scaling of tokenizeParallel from 1 to N worker threads against the serial
+// tokenize, checking that every run yields the identical token stream, also
+// for input with a NUL byte.
+//
+// Usage: parallel_lex_bench [size_mb] [max_threads]   (default 64, all cores)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+static bool sameTokens(const TokenStream &a, const TokenStream &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a.kind(i) != b.kind(i) || a.offset(i) != b.offset(i) || a.text(i) != b.text(i)) return false;
+        if (a.kind(i) == TokenKind::Number && a.number(i) != b.number(i)) return false;
+    }
+    return true;
+}
+
+// The tokens, or the error, tokenize gives src.
+template <class Tokenize>
+static variant<TokenStream, string> lexOrError(Tokenize &&tokenize) {
+    try {
+        return tokenize();
+    } catch (const SourceError &e) {
+        return to_string(e.offset) + ": " + e.what();
+    }
+}
+
+// Input with a NUL byte in it: the serial lexer stops there, so the parallel
+// one must neither return tokens nor report errors from past it.
+static bool sameAtNul(const string &src, unsigned threads) {
+    string withNul = src.substr(0, src.size() / 3) + '\0' + src.substr(src.size() / 3) + " @";
+    ThreadPool pool(threads);
+    auto serial = lexOrError([&] { return tokenize(withNul); });
+    auto par = lexOrError([&] { return tokenizeParallel(withNul, pool); });
+    if (serial.index() != par.index()) return false;
+    if (auto *e = get_if<string>(&serial)) return *e == get<string>(par);
+    return sameTokens(get<TokenStream>(serial), get<TokenStream>(par));
+}
+
+int main(int argc, char *argv[]) {
+    size_t size = (argc > 1 ? stoul(argv[1]) : 64) << 20;
+    unsigned maxThreads = argc > 2 ? stoul(argv[2]) : ThreadPool::default_threads();
+
+    string src;
+    src.reserve(size + 128);
+    for (size_t i = 0; src.size() < size; ++i) {
+        src += "value_" + to_string(i % 5000) + " = (" + to_string(i) + ".25 + rate) * 3; print value_"
+             + to_string(i % 5000) + ";\n";
+    }
+    double mb = src.size() / double(1 << 20);
+    cout << "input: " << mb << " MB, " << ThreadPool::default_threads() << " hardware threads\n";
+
+    auto t0 = bench::Clock::now();
+    TokenStream serial = tokenize(src);
+    double base = bench::seconds_since(t0);
+    cout << "serial:    " << mb / base << " MB/s (" << serial.size() << " tokens)\n";
+
+    for (unsigned n = 1; n <= maxThreads; n *= 2) {
+        ThreadPool pool(n);
+        auto t1 = bench::Clock::now();
+        TokenStream par = tokenizeParallel(src, pool);
+        double secs = bench::seconds_since(t1);
+        cout << n << " thread" << (n == 1 ? ": " : "s:") << "  " << mb / secs << " MB/s, speedup "
+             << base / secs << (sameTokens(serial, par) ? "" : "  MISMATCH") << "\n";
+        if (n < maxThreads && n * 2 > maxThreads) n = maxThreads / 2;
+    }
+    bool nulOk = sameAtNul(src, max(maxThreads, 2u));
+    cout << "embedded NUL: " << (nulOk ? "identical" : "MISMATCH") << "\n";
+    return nulOk ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+// Heap allocations made while parsing, counted by replacing operator new.
+// The index-based Parser should allocate only Arena blocks for its nodes
+// plus the amortized growth of its program and operator stacks; no token
+// or name strings are copied. The make_unique parser from legacy.hpp is
+// shown for comparison.
+//
+// Usage: parse_alloc_bench [statements]   (default 100000)
+
+#include "alloc_count.hpp"
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 100000;
+    string src;
+    for (size_t i = 0; i < statements; i += 2) {
+        src += "value_" + to_string(i % 977) + " = (" + to_string(i) + ".5 + rate) * -3 - base / 2;\n";
+        src += "print value_" + to_string(i % 977) + " * (1 + 2 * (3 - x));\n";
+    }
+    TokenStream toks = tokenize(src);
+
+    Arena arena;
+    uint64_t h0 = alloc_count::heap();
+    size_t parsed = Parser(toks, arena).parseProgram().size();
+    uint64_t heap = alloc_count::heap() - h0;
+
+    uint64_t l0 = alloc_count::heap();
+    size_t legacyParsed = legacy::heap::Parser(toks).parseProgram().size();
+    uint64_t legacyHeap = alloc_count::heap() - l0;
+
+    // Arena::grow is one block malloc plus, now and then, growth of its
+    // block list; the rest is the program vector and the operator stacks.
+    size_t blocks = arena.blocks();
+    cout << parsed << " statements (" << legacyParsed << " legacy), " << toks.size() << " tokens, "
+         << arena.allocations() << " nodes\n";
+    cout << "Parser (indices + Arena): " << heap << " heap allocations: " << blocks
+         << " arena blocks, " << heap - blocks << " vector growth; "
+         << double(heap) / parsed << " per statement\n";
+    cout << "make_unique + std::string: " << legacyHeap << " heap allocations; "
+         << double(legacyHeap) / legacyParsed << " per statement\n";
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Parser throughput of the operator-table (Pratt) expression loop against
+// the previous one-function-per-precedence-level descent, on ordinary
+// statements and on long flat operator chains (a + b * c - d / e ...).
+//
+// Usage: pratt_bench [statements] [rounds]   (default 200000, 4)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+namespace {
+
+template <class P>
+double tokensPerSec(const TokenStream &toks, int rounds) {
+    Arena arena;
+    volatile size_t sink = 0;
+    auto t0 = bench::Clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        arena.reset();
+        P p(toks, arena);
+        sink = sink + p.parseProgram().size();
+    }
+    return double(toks.size()) * rounds / bench::seconds_since(t0);
+}
+
+// Best of several alternating trials, so neither parser gets the warm cache.
+void compare(const char *name, const string &src, int rounds) {
+    TokenStream toks = tokenize(src);
+    double before = 0, after = 0;
+    for (int trial = 0; trial < 5; ++trial) {
+        before = max(before, tokensPerSec<legacy::DescentParser>(toks, rounds));
+        after = max(after, tokensPerSec<Parser>(toks, rounds));
+    }
+    cout << name << ": descent " << before / 1e6 << " M tokens/s, Pratt " << after / 1e6
+         << " M tokens/s, speedup " << after / before << "x\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 4;
+
+    string mixed;
+    for (size_t i = 0; i < statements; ++i) {
+        mixed += "v" + to_string(i % 100) + " = (" + to_string(i) + " + x) * -3 - y / 2;\n";
+    }
+
+    // ops[0..1] are one precedence level, ops[0..3] both.
+    static const char ops[] = "+-*/";
+    auto chains = [&](int kinds) {
+        string out;
+        mt19937 rng(7);
+        for (size_t i = 0; i < statements / 16; ++i) {
+            out += "a";
+            for (int k = 0; k < 64; ++k) {
+                out += ops[rng() % kinds];
+                out += "b" + to_string(k);
+            }
+            out += ";\n";
+        }
+        return out;
+    };
+
+    compare("statements     ", mixed, rounds);
+    compare("chains of + -  ", chains(2), rounds);
+    compare("chains of +-*/ ", chains(4), rounds);
+    return 0;
+}
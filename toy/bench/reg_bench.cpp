@@ -0,0 +1,121 @@
+// VM time on arithmetic-heavy statements: the stack code CodeGen emits
+// against register code (RegCode) for the same trees. Reports how many
+// instructions each dispatches and the time per source operator; both
+// must compute the same results.
+//
+// Usage: reg_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+// Statements are compiled and run a block at a time, as the drivers run
+// code soon after generating it rather than from a program-sized buffer.
+constexpr size_t kBlock = 256;
+
+struct Totals {
+    double stackSecs = 0, regSecs = 0;
+    size_t stackInstrs = 0, regInstrs = 0;
+    vector<Value> stackResults, regResults;
+};
+
+Totals runBlocks(const vector<Expr*> &prog) {
+    Totals t;
+    t.stackResults.reserve(prog.size());
+    t.regResults.reserve(prog.size());
+    ConstPool pool;
+    VM stackVm(pool), regVm(pool);
+    vector<vector<Instr>> stackCode(kBlock);
+    vector<RegCode> regCode(kBlock);
+    for (size_t first = 0; first < prog.size(); first += kBlock) {
+        size_t n = min(kBlock, prog.size() - first);
+        for (size_t i = 0; i < n; ++i) {
+            genForStmt(prog[first + i], pool, stackCode[i]);
+            genForStmt(prog[first + i], pool, regCode[i]);
+            t.stackInstrs += stackCode[i].size();
+            t.regInstrs += regCode[i].code.size();
+        }
+        auto runStack = [&] {
+            auto t0 = bench::Clock::now();
+            for (size_t i = 0; i < n; ++i) t.stackResults.push_back(stackVm.execSingle(stackCode[i]));
+            t.stackSecs += bench::seconds_since(t0);
+        };
+        auto runRegs = [&] {
+            auto t0 = bench::Clock::now();
+            for (size_t i = 0; i < n; ++i) t.regResults.push_back(regVm.execSingle(regCode[i]));
+            t.regSecs += bench::seconds_since(t0);
+        };
+        // Alternately first, as the second finds more of the block cached.
+        if (first / kBlock % 2) {
+            runStack();
+            runRegs();
+        } else {
+            runRegs();
+            runStack();
+        }
+    }
+    return t;
+}
+
+// Runs `statements` statements cycling through forms, after a line that
+// assigns every variable they use, and reports both backends.
+int compare(const char *script, const vector<string> &forms, size_t statements, int rounds) {
+    string src = "n = 5; k = 3; x = 1.5; y = 2.5; rate = 0.75;\n";
+    for (size_t i = 0; i < statements; ++i) src += forms[i % forms.size()] + ";\n";
+    TokenStream toks = tokenize(src);
+    Arena arena;
+    vector<Expr*> prog = Parser(toks, arena).parseProgram();
+    SemanticAnalyzer sem;
+    sem.analyzeProgram(prog);
+
+    size_t ops = 0;
+    for (const Expr *s : prog) walkPostorder(s, [&](const Expr *e) { ops += e->kind == ExprKind::Binary; });
+
+    Totals best = runBlocks(prog);
+    for (int r = 1; r < rounds; ++r) {
+        Totals t = runBlocks(prog);
+        best.stackSecs = min(best.stackSecs, t.stackSecs);
+        best.regSecs = min(best.regSecs, t.regSecs);
+    }
+    if (best.stackResults != best.regResults) {
+        cerr << script << ": register code computes different results\n";
+        return 1;
+    }
+
+    cout << script << ": " << prog.size() << " statements, " << ops << " operators\n";
+    cout << "  stack:    " << best.stackInstrs << " dispatches (" << double(best.stackInstrs) / ops
+         << "/operator), " << best.stackSecs * 1e9 / ops << " ns/operator\n";
+    cout << "  register: " << best.regInstrs << " dispatches (" << double(best.regInstrs) / ops
+         << "/operator), " << best.regSecs * 1e9 / ops << " ns/operator\n";
+    cout << "  dispatches " << double(best.stackInstrs) / best.regInstrs << "x fewer, speedup "
+         << best.stackSecs / best.regSecs << "x\n";
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    // int64 and double statements, a few with conversions between them.
+    vector<string> forms = {
+        "n = (n * 7 + k) - n / 1000 * 7000",
+        "x = x * rate + (y - x) / 4.0",
+        "k = (k + n) * (k - 3) / (n * n + 1) + 1",
+        "y = (x + y) * 0.5 - rate * (x - y) / 8.0",
+        "n * (k + 2) - (n - k) * 3",
+    };
+    // The same expressions four times over in one statement each, so the
+    // cost per statement weighs less.
+    vector<string> longForms;
+    for (const string &f : forms) {
+        size_t eq = f.find('=');
+        string lhs = eq == string::npos ? "" : f.substr(0, eq + 2), e = "(" + f.substr(eq == string::npos ? 0 : eq + 2) + ")";
+        longForms.push_back(lhs + e + " + " + e + " / " + (f[0] == 'x' || f[0] == 'y' ? "8.0" : "8") + " - " + e + " / 16 - " + e + " / 32");
+    }
+    return compare("short statements", forms, statements, rounds) ||
+           compare("long statements", longForms, statements / 4, rounds);
+}
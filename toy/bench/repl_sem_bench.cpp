@@ -0,0 +1,74 @@
+// Semantic analysis over a REPL session in which every line defines a new
+// variable from the one before: analyzeProgram per line, which starts over
+// each time (the REPL before the session kept its definitions), against
+// analyzeNext + settle. Starting over clears and regrows the table of every
+// symbol in the session, so its cost per line grows with the session; the
+// session analyzer's follows the line alone. Also counts the warnings each
+// gives, where no line uses a variable before it is assigned.
+//
+// Usage: repl_sem_bench [lines]   (default 100000)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+struct Line {
+    string text;
+    TokenStream toks;
+    vector<Expr*> prog;
+};
+
+struct Result {
+    double secs = 0;
+    size_t warnings = 0;
+};
+
+// Runs lines [0, n) as the REPL would, timing analysis only.
+Result session(const vector<Line> &lines, size_t n, bool persistent) {
+    Result r;
+    SemanticAnalyzer sem;
+    ConstPool pool;
+    VM vm(pool);
+    vector<Instr> code;
+    for (size_t i = 0; i < n; ++i) {
+        auto t0 = bench::Clock::now();
+        if (persistent) sem.analyzeNext(lines[i].prog);
+        else sem.analyzeProgram(lines[i].prog);
+        r.secs += bench::seconds_since(t0);
+        r.warnings += sem.getWarnings().size();
+        try {
+            for (const Expr *s : lines[i].prog) {
+                genForStmt(s, pool, code);
+                vm.execSingle(code);
+            }
+        } catch (const exception&) {
+        }
+        t0 = bench::Clock::now();
+        if (persistent) sem.settle(vm);
+        r.secs += bench::seconds_since(t0);
+    }
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? stoul(argv[1]) : 100000;
+
+    Arena arena;
+    vector<Line> lines(n);
+    for (size_t i = 0; i < n; ++i) {
+        string v = "v" + to_string(i);
+        lines[i].text = i ? v + " = v" + to_string(i - 1) + " + " + to_string(i) + "; " + v + " * 2" : "v0 = 0";
+        lines[i].toks = tokenize(lines[i].text);
+        lines[i].prog = Parser(lines[i].toks, arena).parseProgram();
+    }
+
+    Result fresh = session(lines, n, false), kept = session(lines, n, true);
+    cout << n << " lines, " << symbols().size() << " symbols\n";
+    cout << "analyzeProgram per line:  " << fresh.secs * 1e9 / n << " ns/line, " << fresh.warnings << " warnings\n";
+    cout << "analyzeNext + settle:     " << kept.secs * 1e9 / n << " ns/line, " << kept.warnings << " warnings\n";
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Throughput of the scan:: run kernels per ISA, and of the final.cpp Lexer
+// against the original one-isspace/isalnum-call-per-byte loops.
+//
+// Usage: scan_bench [size_mb]   (default 64)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+static double gbps(size_t bytes, double secs) { return bytes / secs / 1e9; }
+
+int main(int argc, char* argv[]) {
+    size_t size = (argc > 1 ? stoul(argv[1]) : 64) << 20;
+
+    // Machine-generated shape: long names, long literals, wide indentation.
+    string src;
+    src.reserve(size + 256);
+    for (size_t i = 0; src.size() < size; ++i) {
+        src += "        generated_variable_name_" + to_string(i) + " = 12345678901234.5678 * input_"
+             + to_string(i % 97) + ";\n";
+    }
+
+    cout << "input: " << src.size() / double(1 << 20) << " MB, active isa: "
+         << scan::isa_name(scan::active.isa) << "\n";
+
+    for (scan::Isa isa : {scan::Isa::Scalar, scan::Isa::SSE2, scan::Isa::AVX2}) {
+        if (isa > scan::detect_isa()) continue;
+        scan::Kernels k = scan::kernels_for(isa);
+        const char* p = src.data();
+        const char* end = p + src.size();
+        size_t runs = 0;
+        auto t0 = bench::Clock::now();
+        while (p < end) {
+            const char* q = k.space(p, end);
+            q = k.ident(q, end);
+            q = k.digits(q, end);
+            p = q == p ? p + 1 : q;
+            runs++;
+        }
+        double secs = bench::seconds_since(t0);
+        cout << "kernels " << scan::isa_name(isa) << ": " << gbps(src.size(), secs) << " GB/s (" << runs
+             << " runs)\n";
+    }
+
+    auto lexRate = [&](auto lx, const char* name) {
+        size_t n = 0;
+        auto t0 = bench::Clock::now();
+        while (lx.next().kind != TokenKind::End) n++;
+        double secs = bench::seconds_since(t0);
+        cout << name << gbps(src.size(), secs) << " GB/s (" << n << " tokens)\n";
+    };
+    lexRate(legacy::Lexer(src), "Lexer, per-byte <cctype>: ");
+    lexRate(Lexer(src), "Lexer, scan kernels:      ");
+    return 0;
+}
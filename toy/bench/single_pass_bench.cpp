@@ -0,0 +1,106 @@
+// Compile latency per statement for many short statements: Parser into an
+// arena tree, then genForStmt (the default path), against DirectCompiler
+// emitting the code while it parses (-O0). Both start from the same tokens,
+// compile one statement at a time as Pipeline does, and must produce the
+// same code. Each analyzes as it compiles, the tree by SemanticAnalyzer
+// before genForStmt.
+//
+// Usage: single_pass_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+// Best of several alternating trials.
+template <class F>
+void measure(double &best, F &&f) {
+    auto t0 = bench::Clock::now();
+    f();
+    best = min(best, bench::seconds_since(t0));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    static const char *forms[] = {
+        "a * (b + 3) - c / 2", "-x + 1", "print total", "(rate - 1) * 100", "a + b * c - d",
+    };
+    string src = "a = 1; b = 2; c = 3; d = 4; x = 5; rate = 1.5; total = 0;\n";
+    for (size_t i = 0; i < statements; ++i) {
+        if (i % 3 == 0 && i % 5 != 2) src += "v" + to_string(i % 100) + " = ";
+        src += string(forms[i % 5]) + ";\n";
+    }
+    TokenStream toks = tokenize(src);
+
+    double treeSecs = 1e30, directSecs = 1e30;
+    Arena arena;
+    SemanticAnalyzer treeSem, directSem;
+    ConstPool pool;
+    vector<Instr> code;
+    volatile size_t sink = 0;
+    for (int r = 0; r < rounds; ++r) {
+        measure(treeSecs, [&] {
+            Parser parser(toks, arena);
+            while (true) {
+                arena.reset();
+                Expr *e = parser.parseNext();
+                if (!e) break;
+                pool.clear();
+                treeSem.analyzeNext(e);
+                genForStmt(e, pool, code);
+                sink = sink + code.size();
+            }
+        });
+        measure(directSecs, [&] {
+            DirectCompiler compiler(toks, pool, directSem);
+            while (true) {
+                pool.clear();
+                code.clear();
+                directSem.clearDiagnostics();
+                if (!compiler.compileNext(code)) break;
+                sink = sink + code.size();
+            }
+        });
+    }
+
+    // Same code, statement by statement.
+    Parser parser(toks, arena);
+    treeSem = directSem = SemanticAnalyzer();
+    DirectCompiler compiler(toks, pool, directSem);
+    ConstPool treePool;
+    vector<Instr> direct;
+    bool same = true;
+    while (same) {
+        arena.reset();
+        Expr *e = parser.parseNext();
+        direct.clear();
+        bool more = compiler.compileNext(direct);
+        if (!e || !more) {
+            same = !e && !more;
+            break;
+        }
+        treeSem.analyzeNext(e);
+        genForStmt(e, treePool, code);
+        same = code.size() == direct.size();
+        for (size_t j = 0; same && j < code.size(); ++j) {
+            same = code[j].op == direct[j].op && code[j].pos == direct[j].pos &&
+                   (code[j].op == OpCode::PUSH_CONST ? treePool[code[j].arg] == pool[direct[j].arg]
+                                                     : code[j].arg == direct[j].arg);
+        }
+    }
+    if (!same) {
+        cerr << "direct code differs from the tree's\n";
+        return 1;
+    }
+
+    cout << statements << " statements, " << toks.size() << " tokens\n";
+    cout << "parse + codegen: " << treeSecs * 1e9 / statements << " ns/statement\n";
+    cout << "direct (-O0):    " << directSecs * 1e9 / statements << " ns/statement\n";
+    cout << "speedup: " << treeSecs / directSecs << "x\n";
+    return 0;
+}
@@ -0,0 +1,103 @@
+// VM time on variable-heavy code: LOAD_SLOT / *STORE_SLOT indexing VM's flat
+// frame, against the same code run with variables in a hash map searched by
+// name (as before symbols) and in optional values by symbol (as before the
+// frame); see legacy::vars. All three must compute the same results.
+//
+// Usage: slot_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+namespace {
+
+// Best of several alternating trials.
+template <class F>
+void measure(double &best, F &&f) {
+    auto t0 = bench::Clock::now();
+    f();
+    best = min(best, bench::seconds_since(t0));
+}
+
+template <class Machine>
+uint64_t runAll(Machine &vm, span<const Instr> code, const vector<size_t> &ends, vector<Value> *results = nullptr) {
+    uint64_t sum = 0;
+    size_t begin = 0;
+    for (size_t end : ends) {
+        Value r = vm.execSingle(code.subspan(begin, end - begin));
+        if (results) results->push_back(r);
+        sum += r.bits;
+        begin = end;
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    string src = "rate = 1.5; base = 4; count = 2; total = 0; offset = 3; scale = 0.5;\n";
+    for (size_t i = 0; i < statements; ++i) {
+        switch (i % 3) {
+            case 0: src += "total = total + rate * count - offset / scale;\n"; break;
+            case 1: src += "count = count + 1; base = base * rate - total / count;\n"; ++i; break;
+            case 2: src += "offset = (base - offset) * scale + rate;\n"; break;
+        }
+    }
+    TokenStream toks = tokenize(src);
+    Arena arena;
+    vector<Expr*> prog = Parser(toks, arena).parseProgram();
+
+    SemanticAnalyzer sem;
+    sem.analyzeProgram(prog);
+    ConstPool pool;
+    vector<Instr> code, one;
+    vector<size_t> ends;
+    size_t slotOps = 0;
+    for (const Expr *s : prog) {
+        genForStmt(s, pool, one);
+        code.insert(code.end(), one.begin(), one.end());
+        ends.push_back(code.size());
+    }
+    for (const Instr &i : code) slotOps += i.op == OpCode::LOAD_SLOT || i.op == OpCode::ISTORE_SLOT || i.op == OpCode::FSTORE_SLOT;
+
+    double byName = 1e30, bySymbol = 1e30, frame = 1e30;
+    volatile uint64_t sink = 0;
+    for (int r = 0; r < rounds; ++r) {
+        measure(byName, [&] {
+            legacy::vars::VM<legacy::vars::ByName> vm(pool);
+            sink = sink + runAll(vm, code, ends);
+        });
+        measure(bySymbol, [&] {
+            legacy::vars::VM<legacy::vars::BySymbol> vm(pool);
+            sink = sink + runAll(vm, code, ends);
+        });
+        measure(frame, [&] {
+            VM vm(pool);
+            sink = sink + runAll(vm, code, ends);
+        });
+    }
+
+    vector<Value> a, b, c;
+    legacy::vars::VM<legacy::vars::ByName> vmName(pool);
+    legacy::vars::VM<legacy::vars::BySymbol> vmSymbol(pool);
+    VM vm(pool);
+    runAll(vmName, code, ends, &a);
+    runAll(vmSymbol, code, ends, &b);
+    runAll(vm, code, ends, &c);
+    if (a != c || b != c) {
+        cerr << "frame slots compute different results\n";
+        return 1;
+    }
+
+    size_t n = code.size();
+    cout << prog.size() << " statements, " << n << " instructions, " << slotOps << " loads/stores\n";
+    cout << "hash map by name:   " << byName * 1e9 / n << " ns/instruction\n";
+    cout << "optional by symbol: " << bySymbol * 1e9 / n << " ns/instruction\n";
+    cout << "frame slots:        " << frame * 1e9 / n << " ns/instruction (" << byName / frame << "x, "
+         << bySymbol / frame << "x)\n";
+    return 0;
+}
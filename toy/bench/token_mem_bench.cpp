@@ -0,0 +1,80 @@
+// Memory per token of the struct-of-arrays TokenStream against the original
+// vector<Token> with an owned std::string per token, plus the peak RSS of
+// lexing the same input each way and the time of one pass over the kinds.
+//
+// Usage: token_mem_bench [size_mb]   (default 32)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+#include "legacy.hpp"
+
+namespace {
+
+// Heap bytes behind a legacy token vector: the elements plus any text too
+// long for the small-string buffer.
+size_t legacyBytes(const vector<legacy::Token> &toks) {
+    size_t n = toks.capacity() * sizeof(legacy::Token);
+    for (auto &t : toks) {
+        if (t.text.capacity() > string().capacity()) n += t.text.capacity() + 1;
+    }
+    return n;
+}
+
+vector<legacy::Token> lexLegacy(const string &src) {
+    legacy::Lexer lx(src);
+    vector<legacy::Token> toks;
+    while (true) {
+        toks.push_back(lx.next());
+        if (toks.back().kind == TokenKind::End) break;
+    }
+    return toks;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t size = (argc > 1 ? stoul(argv[1]) : 32) << 20;
+    string src;
+    src.reserve(size + 128);
+    for (size_t i = 0; src.size() < size; ++i) {
+        src += "total_" + to_string(i % 1000) + " = (" + to_string(i) + ".5 + x) * 3; print total_"
+             + to_string(i % 1000) + ";\n";
+    }
+    cout << "input: " << src.size() / double(1 << 20) << " MB\n";
+
+    size_t count = 0, oldBytes = 0, newBytes = 0;
+    double oldScan = 0, newScan = 0;
+    volatile size_t sink = 0;
+    {
+        auto toks = lexLegacy(src);
+        count = toks.size();
+        oldBytes = legacyBytes(toks);
+        auto t0 = bench::Clock::now();
+        size_t s = 0;
+        for (auto &t : toks) s += size_t(t.kind);
+        oldScan = bench::seconds_since(t0);
+        sink = sink + s;
+    }
+    {
+        TokenStream toks = tokenize(src);
+        if (toks.size() != count) cout << "token count MISMATCH\n";
+        newBytes = toks.bytes();
+        auto t0 = bench::Clock::now();
+        size_t s = 0;
+        for (size_t i = 0; i < toks.size(); ++i) s += size_t(toks.kind(i));
+        newScan = bench::seconds_since(t0);
+        sink = sink + s;
+    }
+
+    auto oldRun = bench::run_in_child([&] { return lexLegacy(src).empty() ? -1.0 : 0.0; });
+    auto newRun = bench::run_in_child([&] { return tokenize(src).empty() ? -1.0 : 0.0; });
+
+    cout << count << " tokens\n";
+    cout << "vector<Token> with std::string: " << double(oldBytes) / count << " bytes/token, peak RSS "
+         << oldRun.peak_rss_kb / 1024 << " MB, kind pass " << oldScan * 1e9 / count << " ns/token\n";
+    cout << "TokenStream (struct of arrays): " << double(newBytes) / count << " bytes/token, peak RSS "
+         << newRun.peak_rss_kb / 1024 << " MB, kind pass " << newScan * 1e9 / count << " ns/token\n";
+    cout << "shrink: " << double(oldBytes) / newBytes << "x\n";
+    return 0;
+}
@@ -0,0 +1,105 @@
+// VM time on integer arithmetic with typed opcodes: the same program with
+// int64 literals (IADD, IMUL, ... with overflow checks) and with every
+// literal written as a double (FADD, FMUL, ..., how final.cpp computed
+// everything before types). The values pass 2^53, where doubles stop being
+// exact, so the double run also counts the statements whose result differs
+// from the int64 one.
+//
+// Usage: typed_bench [statements] [rounds]   (default 200000, 5)
+
+#define TOY_FINAL_NO_MAIN
+#include "final.cpp"
+#include "bench.hpp"
+
+namespace {
+
+// Best of several alternating trials.
+template <class F>
+void measure(double &best, F &&f) {
+    auto t0 = bench::Clock::now();
+    f();
+    best = min(best, bench::seconds_since(t0));
+}
+
+struct Program {
+    string src;
+    TokenStream toks;
+    vector<Instr> code;
+    vector<size_t> ends;
+};
+
+// Statements over base = 2^44 whose values reach about 2^58.
+void build(Program &p, size_t statements, bool floats) {
+    auto lit = [&](size_t n) { return to_string(n) + (floats ? ".0" : ""); };
+    p.src = "base = " + lit(17592186044416) + "; acc = " + lit(0) + "; t = " + lit(0) + ";\n";
+    for (size_t i = 0; i < statements; ++i) {
+        string k = lit(i % 1000), j = lit(i % 97);
+        switch (i % 3) {
+            case 0: p.src += "acc = base * " + k + " + " + j + " * " + lit(12345) + " - acc;\n"; break;
+            case 1: p.src += "t = acc * " + lit(2) + " + " + k + " - base;\n"; break;
+            case 2: p.src += "u = (t - acc) * " + lit(3) + " + " + j + ";\n"; break;
+        }
+    }
+    p.toks = tokenize(p.src);
+}
+
+void compile(Program &p, ConstPool &pool) {
+    Arena arena;
+    vector<Expr*> prog = Parser(p.toks, arena).parseProgram();
+    SemanticAnalyzer sem;
+    sem.analyzeProgram(prog);
+    vector<Instr> one;
+    for (const Expr *s : prog) {
+        genForStmt(s, pool, one);
+        p.code.insert(p.code.end(), one.begin(), one.end());
+        p.ends.push_back(p.code.size());
+    }
+}
+
+uint64_t runAll(const Program &p, const ConstPool &pool, vector<Value> *results = nullptr) {
+    VM vm(pool);
+    span<const Instr> code(p.code);
+    uint64_t sum = 0;
+    size_t begin = 0;
+    for (size_t end : p.ends) {
+        Value r = vm.execSingle(code.subspan(begin, end - begin));
+        if (results) results->push_back(r);
+        sum += r.bits;
+        begin = end;
+    }
+    return sum;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    size_t statements = argc > 1 ? stoul(argv[1]) : 200000;
+    int rounds = argc > 2 ? stoi(argv[2]) : 5;
+
+    Program ints, floats;
+    build(ints, statements, false);
+    build(floats, statements, true);
+    ConstPool pool;
+    compile(ints, pool);
+    compile(floats, pool);
+
+    double intSecs = 1e30, floatSecs = 1e30;
+    volatile uint64_t sink = 0;
+    for (int r = 0; r < rounds; ++r) {
+        measure(intSecs, [&] { sink = sink + runAll(ints, pool); });
+        measure(floatSecs, [&] { sink = sink + runAll(floats, pool); });
+    }
+
+    vector<Value> a, b;
+    runAll(ints, pool, &a);
+    runAll(floats, pool, &b);
+    size_t inexact = 0;
+    for (size_t i = 0; i < a.size(); ++i) inexact += b[i].f() != double(a[i].i()) || int64_t(b[i].f()) != a[i].i();
+
+    cout << a.size() << " statements, " << ints.code.size() << " int64 instructions, " << floats.code.size()
+         << " double instructions\n";
+    cout << "int64:  " << intSecs * 1e9 / ints.code.size() << " ns/instruction, exact\n";
+    cout << "double: " << floatSecs * 1e9 / floats.code.size() << " ns/instruction, " << inexact
+         << " results differ from int64\n";
+    return 0;
+}
@@ -1,11 +1,17 @@
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
-#include <cctype>
-#include <memory>
+#include <string_view>
 #include <stdexcept>
 #include <unordered_map>
 
+#include "arena.hpp"
+#include "lex_table.hpp"
+#include "node_visit.hpp"
+#include "number.hpp"
+#include "op_table.hpp"
+
 // =====================
 //  TOKENS
 // =====================
@@ -15,106 +21,117 @@ enum class TokenType {
     Plus, Minus, Star, Slash,
     LParen, RParen,
     Assign,     // '='
-    End
+    End,
+    Invalid
 };
 
+// text views the Lexer's input, which the caller keeps alive.
 struct Token {
     TokenType type;
-    std::string text;
+    std::string_view text;
 };
 
 // =====================
 //  LEXER
 // =====================
+static constexpr lex::Dfa kTokenDfa = lex::make_dfa({.underscoreIdent = false, .fractions = false});
+static constexpr lex::PunctTable<TokenType> kPuncts = lex::make_punct_table<TokenType>({
+    {'+', TokenType::Plus},   {'-', TokenType::Minus},
+    {'*', TokenType::Star},   {'/', TokenType::Slash},
+    {'(', TokenType::LParen}, {')', TokenType::RParen},
+    {'=', TokenType::Assign},
+}, TokenType::Invalid);
+
 class Lexer {
-    std::string input;
+    std::string_view input;
     size_t pos = 0;
 
 public:
-    Lexer(const std::string& s) : input(s) {}
+    Lexer(std::string_view s) : input(s) {}
 
     Token next() {
-        while (pos < input.size() && isspace(input[pos])) pos++;
+        const char* end = input.data() + input.size();
+        pos = scan::skip_space(input.data() + pos, end) - input.data();
 
         if (pos >= input.size()) return {TokenType::End, ""};
 
-        char c = input[pos];
-
-        if (isdigit(c)) {
-            std::string num;
-            while (pos < input.size() && isdigit(input[pos])) {
-                num.push_back(input[pos++]);
-            }
-            return {TokenType::Number, num};
-        }
-
-        if (isalpha(c)) {
-            std::string id;
-            while (pos < input.size() && isalnum(input[pos])) {
-                id.push_back(input[pos++]);
-            }
-            return {TokenType::Identifier, id};
+        size_t start = pos;
+        lex::Match m = lex::match(kTokenDfa, input.data() + pos, end);
+        if (m.shape != lex::Shape::None) {
+            pos = m.end - input.data();
+            TokenType type = m.shape == lex::Shape::Number ? TokenType::Number : TokenType::Identifier;
+            return {type, input.substr(start, pos - start)};
         }
 
-        pos++;
-        switch (c) {
-            case '+': return {TokenType::Plus, "+"};
-            case '-': return {TokenType::Minus, "-"};
-            case '*': return {TokenType::Star, "*"};
-            case '/': return {TokenType::Slash, "/"};
-            case '(': return {TokenType::LParen, "("};
-            case ')': return {TokenType::RParen, ")"};
-            case '=': return {TokenType::Assign, "="};
-        }
-
-        throw std::runtime_error(std::string("Unexpected char: ") + c);
+        char c = input[pos++];
+        TokenType type = kPuncts[(unsigned char)c];
+        if (type == TokenType::Invalid)
+            throw std::runtime_error(std::string("Unexpected char: ") + c);
+        return {type, input.substr(pos - 1, 1)};
     }
 };
 
 // =====================
 //  AST NODES
 // =====================
+// Nodes are allocated from an Arena and released with it.
+enum class ExprKind : uint8_t { Number, Var, Assign, Binary };
+
 struct Expr {
+    const ExprKind kind;
+    explicit Expr(ExprKind k) : kind(k) {}
     virtual ~Expr() = default;
 };
 
 struct NumberExpr : Expr {
     int value;
-    NumberExpr(int v) : value(v) {}
+    NumberExpr(int v) : Expr(ExprKind::Number), value(v) {}
 };
 
 struct VarExpr : Expr {
-    std::string name;
-    VarExpr(const std::string& n) : name(n) {}
+    std::string_view name;
+    VarExpr(std::string_view n) : Expr(ExprKind::Var), name(n) {}
 };
 
 struct AssignExpr : Expr {
-    std::string name;
-    std::unique_ptr<Expr> value;
-    AssignExpr(const std::string& n, std::unique_ptr<Expr> v)
-    : name(n), value(std::move(v)) {}
+    std::string_view name;
+    Expr* value;
+    AssignExpr(std::string_view n, Expr* v) : Expr(ExprKind::Assign), name(n), value(v) {}
 };
 
 struct BinaryExpr : Expr {
     char op;
-    std::unique_ptr<Expr> left, right;
-    BinaryExpr(char o, std::unique_ptr<Expr> l, std::unique_ptr<Expr> r)
-    : op(o), left(std::move(l)), right(std::move(r)) {}
+    Expr *left, *right;
+    BinaryExpr(char o, Expr* l, Expr* r) : Expr(ExprKind::Binary), op(o), left(l), right(r) {}
 };
 
+// Hands e to f as its node type; codegen rewrites nodes, so e is mutable.
+template <class F>
+decltype(auto) visitExpr(Expr& e, F&& f) {
+    return ast::visit_kind<NumberExpr, VarExpr, AssignExpr, BinaryExpr>(e, f);  // ExprKind order
+}
+
 // =====================
 //  PARSER
 // =====================
+static constexpr auto kOps = parse::make_op_table<TokenType>({
+    {TokenType::Plus, '+', 1}, {TokenType::Minus, '-', 1},
+    {TokenType::Star, '*', 2}, {TokenType::Slash, '/', 2},
+});
+
+// Reads the caller's token vector in place; names in the tree view the
+// source line, so neither is copied.
 class Parser {
-    std::vector<Token> tokens;
+    const std::vector<Token>& tokens;
+    Arena& arena;
     size_t pos = 0;
 
-    Token& peek() {
+    const Token& peek() {
         if (pos >= tokens.size()) throw std::runtime_error("Unexpected end");
         return tokens[pos];
     }
 
-    Token get() { return tokens[pos++]; }
+    const Token& get() { return tokens[pos++]; }
 
     bool match(TokenType t) {
         if (pos < tokens.size() && tokens[pos].type == t) {
@@ -125,19 +142,19 @@ class Parser {
     }
 
 public:
-    Parser(std::vector<Token> toks) : tokens(std::move(toks)) {}
+    Parser(const std::vector<Token>& toks, Arena& a) : tokens(toks), arena(a) {}
 
-    std::unique_ptr<Expr> parse() {
+    Expr* parse() {
         return parseStatement();
     }
 
 private:
-    std::unique_ptr<Expr> parseStatement() {
+    Expr* parseStatement() {
         if (peek().type == TokenType::Identifier) {
-            Token id = get();
+            const Token& id = get();
             if (match(TokenType::Assign)) {
                 auto val = parseExpression();
-                return std::make_unique<AssignExpr>(id.text, std::move(val));
+                return arena.make<AssignExpr>(id.text, val);
             } else {
                 pos--; // rollback if not assignment
             }
@@ -145,42 +162,60 @@ private:
         return parseExpression();
     }
 
-    std::unique_ptr<Expr> parseExpression() {
-        auto node = parseTerm();
-        while (pos < tokens.size() &&
-            (peek().type == TokenType::Plus || peek().type == TokenType::Minus)) {
-            char op = get().text[0];
-        auto rhs = parseTerm();
-        node = std::make_unique<BinaryExpr>(op, std::move(node), std::move(rhs));
+    // The whole line after any 'name ='. Operands collect on vals and
+    // '(' and operators on ops; an operator that binds no tighter than the
+    // one pending (kOps, see op_table.hpp) first folds it into a BinaryExpr.
+    // Both stacks are vectors, so deep parentheses do not recurse.
+    Expr* parseExpression() {
+        std::vector<Pending> ops;
+        std::vector<Expr*> vals;
+        auto reduce = [&] {
+            Pending p = ops.back();
+            ops.pop_back();
+            Expr* rhs = vals.back();
+            vals.pop_back();
+            vals.back() = arena.make<BinaryExpr>(p.infix.op, vals.back(), rhs);
+        };
+        size_t open = 0;  // '(' on ops
+        while (true) {
+            // Operand, after any '('.
+            while (peek().type == TokenType::LParen) {
+                get();
+                ops.push_back({true});
+                ++open;
             }
-            return node;
-    }
-
-    std::unique_ptr<Expr> parseTerm() {
-        auto node = parseFactor();
-        while (pos < tokens.size() &&
-            (peek().type == TokenType::Star || peek().type == TokenType::Slash)) {
-            char op = get().text[0];
-        auto rhs = parseFactor();
-        node = std::make_unique<BinaryExpr>(op, std::move(node), std::move(rhs));
+            const Token& tok = get();
+            if (tok.type == TokenType::Number) {
+                int value = 0;
+                if (!lex::parse_int(tok.text, value))
+                    throw std::runtime_error("Number out of range: " + std::string(tok.text));
+                vals.push_back(arena.make<NumberExpr>(value));
+            } else if (tok.type == TokenType::Identifier) {
+                vals.push_back(arena.make<VarExpr>(tok.text));
+            } else {
+                throw std::runtime_error("Unexpected token: " + std::string(tok.text));
             }
-            return node;
-    }
 
-    std::unique_ptr<Expr> parseFactor() {
-        Token tok = get();
-        if (tok.type == TokenType::Number) {
-            return std::make_unique<NumberExpr>(std::stoi(tok.text));
-        } else if (tok.type == TokenType::Identifier) {
-            return std::make_unique<VarExpr>(tok.text);
-        } else if (tok.type == TokenType::LParen) {
-            auto expr = parseExpression();
-            if (!match(TokenType::RParen))
-                throw std::runtime_error("Missing ')'");
-            return expr;
+            // Operator, after any ')' closing groups.
+            while (open > 0 && match(TokenType::RParen)) {
+                while (!ops.back().paren) reduce();
+                ops.pop_back();
+                --open;
+            }
+            if (pos >= tokens.size() || kOps[tokens[pos].type].lbp == 0) break;
+            parse::Infix op = kOps[get().type];
+            while (!ops.empty() && !ops.back().paren && ops.back().infix.rbp >= op.lbp) reduce();
+            ops.push_back({false, op});
         }
-        throw std::runtime_error("Unexpected token: " + tok.text);
+        if (open > 0) throw std::runtime_error("Missing ')'");
+        while (!ops.empty()) reduce();
+        return vals.back();
     }
+
+    struct Pending {
+        bool paren;
+        parse::Infix infix {};
+    };
 };
 
 // =====================
@@ -188,28 +223,58 @@ private:
 // =====================
 std::unordered_map<std::string, int> variables;
 
-int eval(Expr* expr) {
-    if (auto num = dynamic_cast<NumberExpr*>(expr)) {
-        return num->value;
-    } else if (auto var = dynamic_cast<VarExpr*>(expr)) {
-        if (variables.find(var->name) == variables.end())
-            throw std::runtime_error("Undefined variable: " + var->name);
-        return variables[var->name];
-    } else if (auto assign = dynamic_cast<AssignExpr*>(expr)) {
-        int val = eval(assign->value.get());
-        variables[assign->name] = val;
-        return val;
-    } else if (auto bin = dynamic_cast<BinaryExpr*>(expr)) {
-        int left = eval(bin->left.get());
-        int right = eval(bin->right.get());
-        switch (bin->op) {
-            case '+': return left + right;
-            case '-': return left - right;
-            case '*': return left * right;
-            case '/': return right != 0 ? left / right : throw std::runtime_error("Divide by zero");
+// The line's value. A node is seen twice: first to queue its children,
+// then, with their results on top of values, to compute its own. The queue
+// is a vector, so a deeply nested line does not recurse.
+int eval(Expr* root) {
+    struct Frame { Expr* e; bool expanded; };
+    std::vector<Frame> stack{{root, false}};
+    std::vector<int> values;
+    while (!stack.empty()) {
+        auto [expr, expanded] = stack.back();
+        if (!expanded) {
+            stack.back().expanded = true;
+            visitExpr(*expr, ast::Overloaded{
+                [&](AssignExpr& assign) { stack.push_back({assign.value, false}); },
+                [&](BinaryExpr& bin) {
+                    stack.push_back({bin.right, false});
+                    stack.push_back({bin.left, false});
+                },
+                [](auto&) {},
+            });
+            continue;
         }
+        stack.pop_back();
+
+        visitExpr(*expr, ast::Overloaded{
+            [&](NumberExpr& num) { values.push_back(num.value); },
+            [&](VarExpr& var) {
+                std::string name(var.name);
+                auto it = variables.find(name);
+                if (it == variables.end())
+                    throw std::runtime_error("Undefined variable: " + name);
+                values.push_back(it->second);
+            },
+            [&](AssignExpr& assign) { variables[std::string(assign.name)] = values.back(); },
+            [&](BinaryExpr& bin) {
+                int right = values.back();
+                values.pop_back();
+                int left = values.back();
+                switch (bin.op) {
+                    case '+': values.back() = left + right; break;
+                    case '-': values.back() = left - right; break;
+                    case '*': values.back() = left * right; break;
+                    case '/': {
+                        if (right == 0) throw std::runtime_error("Divide by zero");
+                        values.back() = left / right;
+                        break;
+                    }
+                    default: throw std::runtime_error("Unknown expression type");
+                }
+            },
+        });
     }
-    throw std::runtime_error("Unknown expression type");
+    return values.back();
 }
 
 // =====================
@@ -218,6 +283,7 @@ int eval(Expr* expr) {
 int main() {
     std::cout << "Mini Compiler with Variables. Type 'exit' to quit.\n";
 
+    Arena arena;
     while (true) {
         std::cout << "> ";
         std::string line;
@@ -232,10 +298,11 @@ int main() {
                 tokens.push_back(t);
             }
 
-            Parser parser(tokens);
+            arena.reset();
+            Parser parser(tokens, arena);
             auto tree = parser.parse();
 
-            int result = eval(tree.get());
+            int result = eval(tree);
             std::cout << result << "\n";
         } catch (std::exception& e) {
             std::cerr << "Error: " << e.what() << "\n";
@@ -0,0 +1,54 @@
+global _start
+_start:
+    mov rbp, rsp
+    mov rax, 6
+    call toy_print
+    lea rsi, [rel undefined_0]
+    mov rdx, undefined_0_len
+    jmp toy_fail
+toy_print:
+    sub rsp, 32
+    lea rsi, [rsp + 31]
+    mov byte [rsi], 10
+    mov r8, rax
+    test rax, rax
+    jns .digits
+    neg rax
+.digits:
+    mov rcx, 10
+.next:
+    xor edx, edx
+    div rcx
+    add dl, '0'
+    dec rsi
+    mov [rsi], dl
+    test rax, rax
+    jnz .next
+    test r8, r8
+    jns .write
+    dec rsi
+    mov byte [rsi], '-'
+.write:
+    lea rdx, [rsp + 32]
+    sub rdx, rsi
+    mov rax, 1
+    mov rdi, 1
+    syscall
+    add rsp, 32
+    ret
+toy_overflow:
+    lea rsi, [rel overflow_msg]
+    mov rdx, overflow_msg_len
+    jmp toy_fail
+toy_fail:
+    mov rax, 1
+    mov rdi, 2
+    syscall
+    mov rax, 60
+    mov rdi, 1
+    syscall
+section .rodata
+undefined_0: db "VM: undefined variable 'x'", 10
+undefined_0_len equ $ - undefined_0
+overflow_msg: db "VM: int64 overflow", 10
+overflow_msg_len equ $ - overflow_msg
@@ -1,8 +1,90 @@
 #include <bits/stdc++.h>
+#include "arena.hpp"
+#include "keywords.hpp"
+#include "lex_table.hpp"
+#include "line_index.hpp"
+#include "nasm.hpp"
+#include "node_visit.hpp"
+#include "number.hpp"
+#include "op_table.hpp"
+#include "parallel_lex.hpp"
+#include "source_buffer.hpp"
+#include "stream_buffer.hpp"
+#include "symbols.hpp"
 using namespace std;
 
+/* ------------------- Diagnostics ------------------- */
+/* An error at a byte offset of the text being run. The offset becomes a
+ *   line and column only when the error is reported (see Locate). */
+struct SourceError : runtime_error {
+    uint32_t offset;
+    SourceError(uint32_t off, const string &msg): runtime_error(msg), offset(off) {}
+};
+
+struct Diagnostic {
+    uint32_t offset;
+    string message;
+};
+
+// Prefix naming a source offset in messages, e.g. "prog.toy:3:14: ".
+using Locate = function<string(uint32_t)>;
+
+inline Locate lineColIn(string name, string_view src) {
+    auto lines = make_shared<lex::LineIndex>(src);
+    return [name = move(name), lines](uint32_t off) {
+        lex::LineCol lc = lines->at(off);
+        return name + ":" + to_string(lc.line) + ":" + to_string(lc.col) + ": ";
+    };
+}
+
+inline void reportError(const exception &ex, const Locate &where) {
+    auto se = dynamic_cast<const SourceError*>(&ex);
+    cerr << (se ? where(se->offset) : "") << "Error: " << ex.what() << "\n";
+}
+
+/* ------------------- Values: int64 and double ------------------- */
+/* Every value is an int64 or a double, and which one is known before the
+ *   program runs: a literal by its spelling (with a '.' or beyond 2^53 it
+ *   is a double), a variable by the values assigned to it so far (int64
+ *   until it is assigned a double), +, - and * by their operands (int64
+ *   when both are); / always divides doubles, so 7 / 2 is 3.5. At run
+ *   time a value is an untyped 8-byte cell; the instructions that make and
+ *   use it carry its type. */
+enum class Type : uint8_t { Int, Float };
+
+struct Value {
+    uint64_t bits = 0;
+    static constexpr Value ofInt(int64_t i) { return {uint64_t(i)}; }
+    static constexpr Value ofFloat(double f) { return {bit_cast<uint64_t>(f)}; }
+    int64_t i() const { return int64_t(bits); }
+    double f() const { return bit_cast<double>(bits); }
+    bool operator==(const Value&) const = default;
+};
+
+struct Literal {
+    Value value;
+    Type type = Type::Int;
+    bool operator==(const Literal&) const = default;
+};
+
+// The type that holds values of types a and b: int64 only when both are.
+static Type join(Type a, Type b) {
+    return a == Type::Int && b == Type::Int ? Type::Int : Type::Float;
+}
+
+// Type of binary operator op's result on operands of types lhs and rhs.
+static Type binaryType(char op, Type lhs, Type rhs) {
+    return op == '/' ? Type::Float : join(lhs, rhs);
+}
+
+static void printValue(Value v, Type t) {
+    cout.setf(std::ios::fmtflags(0), ios::floatfield);
+    if (t == Type::Int) cout << v.i() << "\n";
+    else cout << v.f() << "\n";
+}
+
 /* ------------------- Tokens / Lexer ------------------- */
-enum class TokenKind {
+enum class TokenKind : uint8_t {
     End,
     Number,
     Identifier,
@@ -14,431 +96,2742 @@ enum class TokenKind {
     Invalid
 };
 
+/* One token as the lexers hand it out. The text is not copied: it is
+ *   [offset, offset + length) of the lexer's input. */
 struct Token {
     TokenKind kind;
-    string text;
-    double number = 0.0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    Literal number{};
+    Symbol symbol = SymbolTable::kNone;  // Identifier, when interned
 };
 
-static bool isKeywordPrint(const string &s) {
-    return s == "print";
+/* Every identifier is interned here as it is lexed; from then on tokens,
+ *   nodes, instructions and the VM carry only its Symbol. */
+static SymbolTable &symbols() {
+    static SymbolTable table;
+    return table;
+}
+
+static constexpr auto kKeywords = lex::make_keywords<TokenKind>({
+    {"print", TokenKind::KeywordPrint},
+});
+
+// Identifiers and numbers come from the DFA; everything else is one char.
+static constexpr lex::Dfa kTokenDfa = lex::make_dfa({.underscoreIdent = true, .fractions = true});
+static constexpr lex::PunctTable<TokenKind> kPuncts = lex::make_punct_table<TokenKind>({
+    {'+', TokenKind::Plus},   {'-', TokenKind::Minus},
+    {'*', TokenKind::Star},   {'/', TokenKind::Slash},
+    {'(', TokenKind::LParen}, {')', TokenKind::RParen},
+    {'=', TokenKind::Assign}, {';', TokenKind::Semicolon},
+}, TokenKind::Invalid);
+
+// Byte after the token starting at p, given its DFA match.
+static const char *tokenEnd(const char *p, const lex::Match &m) {
+    return m.shape == lex::Shape::None ? p + 1 : m.end;
+}
+
+// Largest integer literal typed int64. Up to it a double holds every integer
+// exactly; larger ones stay doubles, as every literal once was, so that
+// 9223372036854775807 + 1 still computes.
+static constexpr int64_t kMaxExactInt = int64_t(1) << 53;
+
+// Builds the token starting at p (input offset `offset`) from its DFA match.
+// Identifiers are interned unless `intern` is false (see tokenizeParallel).
+static Token makeToken(const char *p, const lex::Match &m, uint32_t offset, bool intern = true) {
+    uint32_t len = uint32_t(tokenEnd(p, m) - p);
+    // Number: int64, or double with a decimal point or beyond kMaxExactInt
+    if (m.shape == lex::Shape::Number) {
+        string_view s(p, len);
+        Token t{TokenKind::Number, offset, len};
+        bool ok;
+        int64_t i;
+        if (s.find('.') == string_view::npos && lex::parse_int(s, i) && i <= kMaxExactInt) {
+            ok = true;
+            t.number = {Value::ofInt(i), Type::Int};
+        } else {
+            double f;
+            ok = lex::parse_number(s, f);
+            t.number = {Value::ofFloat(f), Type::Float};
+        }
+        if (!ok) throw SourceError(offset, "Lexer: numeric literal out of range '" + string(s) + "'");
+        return t;
+    }
+
+    // Identifier / keyword (letters, digits, underscore)
+    if (m.shape == lex::Shape::Identifier) {
+        string_view text(p, len);
+        if (auto kw = kKeywords.find(text)) return {*kw, offset, len};
+        Token t{TokenKind::Identifier, offset, len};
+        if (intern) t.symbol = symbols().intern(text);
+        return t;
+    }
+
+    // single-char tokens
+    return {kPuncts[(unsigned char)*p], offset, 1};
 }
 
 class Lexer {
-    string in;
+    string_view in;
     size_t pos = 0;
+    bool intern;
 public:
-    Lexer(string s): in(move(s)), pos(0) {}
+    Lexer(string_view s, bool internNames = true): in(s), pos(0), intern(internNames) {}
     char peek() const { return pos < in.size() ? in[pos] : '\0'; }
     char get() { return pos < in.size() ? in[pos++] : '\0'; }
-    void skipWS() { while (isspace((unsigned char)peek())) get(); }
+    const char* at() const { return in.data() + pos; }
+    const char* endp() const { return in.data() + in.size(); }
+    void skipWS() { pos = scan::skip_space(at(), endp()) - in.data(); }
 
     Token next() {
         skipWS();
         char c = peek();
-        if (c == '\0') return {TokenKind::End, ""};
-
-        // Number (allow decimal)
-        if (isdigit((unsigned char)c) || (c == '.' && pos + 1 < in.size() && isdigit((unsigned char)in[pos+1]))) {
-            string s;
-            bool seen_dot = false;
-            while (isdigit((unsigned char)peek()) || (!seen_dot && peek() == '.')) {
-                if (peek() == '.') seen_dot = true;
-                s.push_back(get());
+        if (c == '\0') return {TokenKind::End, uint32_t(pos)};
+
+        lex::Match m = lex::match(kTokenDfa, at(), endp());
+        const char *p = at();
+        uint32_t offset = uint32_t(pos);
+        pos = tokenEnd(p, m) - in.data();
+        return makeToken(p, m, offset, intern);
+    }
+};
+
+/* Same tokens as Lexer, read from a file descriptor through a fixed-size
+ *   window so memory stays bounded on unbounded input (pipes, generators).
+ *   Offsets count from the start of the stream, modulo 2^32. */
+class StreamLexer {
+    StreamBuffer buf;
+    string_view last;
+public:
+    // A token that does not fit the window. next() cannot get past it, so
+    // nothing after it can be read.
+    struct TokenTooLong : SourceError { using SourceError::SourceError; };
+
+    explicit StreamLexer(int fd, size_t window = 1 << 16): buf(fd, window) {}
+
+    // Text of the token next() returned last; valid until the next call.
+    string_view lastText() const { return last; }
+
+    Token next() {
+        last = {};
+        while (true) {
+            const char *p = scan::skip_space(buf.begin(), buf.end());
+            buf.consume(p);
+            uint32_t offset = uint32_t(buf.offset());
+            if (p == buf.end()) {
+                if (buf.refill()) continue;
+                return {TokenKind::End, offset};
+            }
+            if (*p == '\0') return {TokenKind::End, offset};
+
+            lex::Match m = lex::match(kTokenDfa, p, buf.end());
+            const char *e = tokenEnd(p, m);
+            // A token touching the window edge may continue in unread input.
+            if (e == buf.end() && !buf.eof()) {
+                if (!buf.refill() && buf.full()) throw TokenTooLong(offset, "Lexer: token longer than the stream window");
+                continue;
+            }
+            // consume() only moves the window start; [p, e) stays readable.
+            buf.consume(e);
+            last = string_view(p, e - p);
+            return makeToken(p, m, offset);
+        }
+    }
+};
+
+/* ------------------- Token stream: struct of arrays ------------------- */
+/* The tokens of one source text as parallel arrays: a kind byte and a
+ *   source offset per token, plus one 32-bit word whose meaning depends on
+ *   the kind (identifier Symbol, keyword length, or index into `literals`
+ *   for numbers). Punctuation is always one byte long, so it needs nothing
+ *   else. That is 9 bytes per token with no per-token heap allocation; text
+ *   is sliced out of the source on demand, so the source must outlive the
+ *   stream. */
+class TokenStream {
+    string_view src;
+    vector<TokenKind> kinds;
+    vector<uint32_t> offsets;
+    vector<uint32_t> aux;
+    vector<Literal> literals;
+public:
+    TokenStream() = default;
+    explicit TokenStream(string_view s): src(s) {}
+
+    string_view source() const { return src; }
+    void setSource(string_view s) { src = s; }
+
+    size_t size() const { return kinds.size(); }
+    bool empty() const { return kinds.empty(); }
+    TokenKind kind(size_t i) const { return kinds[i]; }
+    uint32_t offset(size_t i) const { return offsets[i]; }
+    Literal number(size_t i) const { return literals[aux[i]]; }
+    Symbol symbol(size_t i) const { return aux[i]; }
+
+    string_view text(size_t i) const {
+        switch (kinds[i]) {
+            case TokenKind::End: return {};
+            case TokenKind::KeywordPrint: return src.substr(offsets[i], aux[i]);
+            case TokenKind::Identifier:
+                if (aux[i] != SymbolTable::kNone) return symbols().name(aux[i]);
+                [[fallthrough]];  // not interned yet: measure it like a number
+            case TokenKind::Number: {
+                const char *p = src.data() + offsets[i];
+                return string_view(p, lex::match(kTokenDfa, p, src.data() + src.size()).end - p);
             }
-            Token t; t.kind = TokenKind::Number; t.text = s; t.number = stod(s);
-            return t;
+            default: return src.substr(offsets[i], 1);
         }
+    }
 
-        // Identifier / keyword (letters, digits, underscore)
-        if (isalpha((unsigned char)c) || c == '_') {
-            string id;
-            while (isalnum((unsigned char)peek()) || peek() == '_') id.push_back(get());
-            if (isKeywordPrint(id)) return {TokenKind::KeywordPrint, id};
-            return {TokenKind::Identifier, id};
+    void push(const Token &t) {
+        kinds.push_back(t.kind);
+        offsets.push_back(t.offset);
+        if (t.kind == TokenKind::Number) {
+            aux.push_back(uint32_t(literals.size()));
+            literals.push_back(t.number);
+        } else if (t.kind == TokenKind::Identifier) {
+            aux.push_back(t.symbol);
+        } else {
+            aux.push_back(t.length);
         }
+    }
 
-        // single-char tokens
-        char ch = get();
-        switch (ch) {
-            case '+': return {TokenKind::Plus, "+"};
-            case '-': return {TokenKind::Minus, "-"};
-            case '*': return {TokenKind::Star, "*"};
-            case '/': return {TokenKind::Slash, "/"};
-            case '(': return {TokenKind::LParen, "("};
-            case ')': return {TokenKind::RParen, ")"};
-            case '=': return {TokenKind::Assign, "="};
-            case ';': return {TokenKind::Semicolon, ";"};
-            default: return {TokenKind::Invalid, string(1,ch)};
+    // Appends o, whose offsets are relative to byte `shift` of this source,
+    // interning any identifiers o was lexed without.
+    void append(const TokenStream &o, uint32_t shift) {
+        uint32_t litBase = uint32_t(literals.size());
+        kinds.insert(kinds.end(), o.kinds.begin(), o.kinds.end());
+        offsets.reserve(offsets.size() + o.size());
+        aux.reserve(aux.size() + o.size());
+        for (size_t i = 0; i < o.size(); ++i) {
+            offsets.push_back(o.offsets[i] + shift);
+            uint32_t a = o.aux[i];
+            if (o.kinds[i] == TokenKind::Number) a += litBase;
+            else if (o.kinds[i] == TokenKind::Identifier && a == SymbolTable::kNone) a = symbols().intern(o.text(i));
+            aux.push_back(a);
         }
+        literals.insert(literals.end(), o.literals.begin(), o.literals.end());
+    }
+
+    void reserve(size_t n) {
+        kinds.reserve(n);
+        offsets.reserve(n);
+        aux.reserve(n);
+    }
+
+    // Drops the slack left by growing the arrays one token at a time.
+    void shrinkToFit() {
+        kinds.shrink_to_fit();
+        offsets.shrink_to_fit();
+        aux.shrink_to_fit();
+        literals.shrink_to_fit();
+    }
+
+    void clear() {
+        kinds.clear();
+        offsets.clear();
+        aux.clear();
+        literals.clear();
+    }
+
+    // Heap bytes held by the arrays.
+    size_t bytes() const {
+        return kinds.capacity() * sizeof(TokenKind) + offsets.capacity() * sizeof(uint32_t)
+             + aux.capacity() * sizeof(uint32_t) + literals.capacity() * sizeof(Literal);
     }
 };
 
+/* Lightweight view of token i of a stream, for code that wants one token
+ *   at a time. Two words; copy it freely. */
+struct TokenRef {
+    const TokenStream *ts;
+    size_t i;
+    TokenKind kind() const { return ts->kind(i); }
+    string_view text() const { return ts->text(i); }
+    Literal number() const { return ts->number(i); }
+    Symbol symbol() const { return ts->symbol(i); }
+    uint32_t offset() const { return ts->offset(i); }
+};
+
+/* ------------------- Tokenize: serial or chunked on a pool ------------------- */
+static TokenStream tokenizeChunk(string_view src, bool intern = true) {
+    Lexer lx(src, intern);
+    TokenStream toks(src);
+    while (true) {
+        Token t = lx.next();
+        if (t.kind == TokenKind::Invalid) throw SourceError(t.offset, "Lexer: invalid char '" + string(src.substr(t.offset, 1)) + "'");
+        if (t.kind == TokenKind::End) break;
+        toks.push(t);
+    }
+    return toks;
+}
+
+// Offsets are 32-bit; larger sources are rejected up front.
+static void checkSourceSize(string_view src) {
+    if (src.size() > numeric_limits<uint32_t>::max()) throw runtime_error("Lexer: source larger than 4 GiB");
+}
+
+TokenStream tokenize(string_view src) {
+    checkSourceSize(src);
+    auto toks = tokenizeChunk(src);
+    toks.push({TokenKind::End, uint32_t(src.size())});
+    toks.shrinkToFit();
+    return toks;
+}
+
+// Identical tokens and first error to tokenize(); see parallel_lex.hpp.
+TokenStream tokenizeParallel(string_view src, ThreadPool &pool) {
+    checkSourceSize(src);
+    // Lexer ends the input at a NUL byte, so chunks after it are never lexed.
+    string_view text = src.substr(0, src.find('\0'));
+    // Chunk lexers see offsets within their chunk; errors are rebased to src.
+    // The symbol table is not shared between threads, so names are interned
+    // while the chunks are merged.
+    auto lexChunk = [src](string_view chunk) {
+        try {
+            return tokenizeChunk(chunk, false);
+        } catch (const SourceError &e) {
+            throw SourceError(e.offset + uint32_t(chunk.data() - src.data()), e.what());
+        }
+    };
+    vector<TokenStream> parts = lex::lex_chunks(text, pool, lexChunk);
+    size_t total = 1;
+    for (auto &p : parts) total += p.size();
+
+    TokenStream toks(src);
+    toks.reserve(total);
+    for (auto &p : parts) toks.append(p, uint32_t(p.source().data() - src.data()));
+    toks.push({TokenKind::End, uint32_t(src.size())});
+    toks.shrinkToFit();  // literals grew by appending
+    return toks;
+}
+
 /* ------------------- AST Nodes ------------------- */
-struct Expr { virtual ~Expr() = default; };
+/* Nodes live in an Arena owned by the Session and are dropped together when
+ *   the next run resets it. Variables are Symbols, so parsing copies no
+ *   strings and later passes never compare or hash names. */
+enum class ExprKind : uint8_t { Number, Variable, Binary, Assign, Print };
+
+struct Expr {
+    const ExprKind kind;
+    bool shared = false;  // reached from more than one parent (see HashCons)
+    mutable Type type = Type::Float;  // of its value: a literal's own, else set by SemanticAnalyzer
+    uint32_t pos = 0;  // source offset of the token the node was built from
+    explicit Expr(ExprKind k): kind(k) {}
+    virtual ~Expr() = default;
+};
 
 struct NumberExpr : Expr {
-    double value;
-    NumberExpr(double v): value(v) {}
+    Value value;
+    NumberExpr(Literal l): Expr(ExprKind::Number), value(l.value) { type = l.type; }
 };
 
 struct VariableExpr : Expr {
-    string name;
-    VariableExpr(string n): name(move(n)) {}
+    Symbol sym;
+    VariableExpr(Symbol s): Expr(ExprKind::Variable), sym(s) {}
 };
 
 struct BinaryExpr : Expr {
     char op;
-    unique_ptr<Expr> lhs, rhs;
-    BinaryExpr(char o, unique_ptr<Expr> l, unique_ptr<Expr> r): op(o), lhs(move(l)), rhs(move(r)) {}
+    Expr *lhs, *rhs;
+    BinaryExpr(char o, Expr *l, Expr *r): Expr(ExprKind::Binary), op(o), lhs(l), rhs(r) {}
 };
 
 struct AssignExpr : Expr {
-    string name;
-    unique_ptr<Expr> value;
-    AssignExpr(string n, unique_ptr<Expr> v): name(move(n)), value(move(v)) {}
+    Symbol sym;
+    Expr *value;
+    AssignExpr(Symbol s, Expr *v): Expr(ExprKind::Assign), sym(s), value(v) {}
 };
 
 struct PrintExpr : Expr {
-    unique_ptr<Expr> value;
-    PrintExpr(unique_ptr<Expr> v): value(move(v)) {}
+    Expr *value;
+    PrintExpr(Expr *v): Expr(ExprKind::Print), value(v) {}
+};
+
+/* Calls f with e as its concrete node type (see node_visit.hpp); every
+ *   pass over the tree dispatches through it. The types are in ExprKind
+ *   order. */
+template <class F>
+decltype(auto) visitExpr(const Expr &e, F &&f) {
+    return ast::visit_kind<NumberExpr, VariableExpr, BinaryExpr, AssignExpr, PrintExpr>(e, f);
+}
+
+/* Calls visit(e) for every node under root, children first and left to
+ *   right. The walk keeps its own stack on the heap, so deeply nested trees
+ *   do not overflow the C stack; every pass over the AST goes through it.
+ *   When enter(e) returns false, neither e nor anything under it is visited;
+ *   it is asked once per occurrence, just before the node's children, so a
+ *   shared node's earlier occurrences are finished by then. */
+template <class F, class Enter>
+void walkPostorder(const Expr *root, F &&visit, Enter &&enter) {
+    struct Frame { const Expr *e; bool expanded; };
+    vector<Frame> stack;
+    stack.reserve(16);  // one allocation for a typical statement's depth
+    stack.push_back({root, false});
+    while (!stack.empty()) {
+        auto [e, expanded] = stack.back();
+        if (!e) { stack.pop_back(); continue; }
+        if (expanded) {
+            stack.pop_back();
+            visit(e);
+            continue;
+        }
+        if (!enter(e)) { stack.pop_back(); continue; }
+        stack.back().expanded = true;
+        visitExpr(*e, ast::Overloaded{
+            [&](const BinaryExpr &b) {
+                stack.push_back({b.rhs, false});
+                stack.push_back({b.lhs, false});
+            },
+            [&](const AssignExpr &a) { stack.push_back({a.value, false}); },
+            [&](const PrintExpr &pr) { stack.push_back({pr.value, false}); },
+            [](const auto&) {},
+        });
+    }
+}
+
+template <class F>
+void walkPostorder(const Expr *root, F &&visit) {
+    walkPostorder(root, visit, [](const Expr*) { return true; });
+}
+
+/* ------------------- Hash-consing: share identical subexpressions ------------------- */
+/* Remembers every number, variable and binary node built so far, keyed by
+ *   its contents, so the Parser can hand back an existing node instead of
+ *   building an equal one. Children are interned before their parents, so
+ *   comparing child pointers compares whole subtrees, and repeated
+ *   subexpressions such as both halves of (a+b)*(a+b) become one node with
+ *   two parents: the AST becomes a DAG. Assignments and prints have effects
+ *   and are never shared. A shared node keeps the position of its first
+ *   occurrence, so diagnostics inside it point there. A variable read after
+ *   an assignment to it is a new node, as its type may differ from that of
+ *   reads before (see SemanticAnalyzer).
+ *
+ *   The table refers to nodes in the parser's arena; clear it whenever that
+ *   arena is reset. */
+class HashCons {
+    struct Key {
+        uint8_t kind;  // 0 number, 1 variable, 2 binary
+        char op;  // binary: the operator; number: its Type
+        uint64_t bits;  // number: the value's bit pattern; variable: its Symbol and generation
+        const Expr *lhs, *rhs;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &k) const {
+            size_t h = k.bits * 0x9e3779b97f4a7c15ULL;
+            h ^= (uintptr_t(k.lhs) >> 4) * 0xff51afd7ed558ccdULL + (uintptr_t(k.rhs) >> 4) + (k.kind << 8 | uint8_t(k.op));
+            return h ^ (h >> 29);
+        }
+    };
+    unordered_map<Key, Expr*, KeyHash> table;
+    vector<uint32_t> generations;  // by Symbol: assignments parsed
+    size_t hits = 0;
+
+    // Existing node for k, or the one make() builds.
+    template <class Make>
+    Expr *intern(const Key &k, Make &&make) {
+        auto [it, inserted] = table.try_emplace(k, nullptr);
+        if (inserted) {
+            it->second = make();
+        } else {
+            it->second->shared = true;
+            ++hits;
+        }
+        return it->second;
+    }
+
+public:
+    template <class Make>
+    Expr *number(Literal l, Make &&make) { return intern({0, char(l.type), l.value.bits, nullptr, nullptr}, make); }
+    template <class Make>
+    Expr *variable(Symbol sym, Make &&make) {
+        uint64_t gen = sym < generations.size() ? generations[sym] : 0;
+        return intern({1, 0, gen << 32 | sym, nullptr, nullptr}, make);
+    }
+    template <class Make>
+    Expr *binary(char op, const Expr *l, const Expr *r, Make &&make) { return intern({2, op, 0, l, r}, make); }
+
+    // Call once an assignment to sym is parsed: later reads are new nodes.
+    void assigned(Symbol sym) {
+        if (sym >= generations.size()) generations.resize(symbols().size());
+        ++generations[sym];
+    }
+
+    // Distinct nodes built, and requests answered with one of them.
+    size_t size() const { return table.size(); }
+    size_t reused() const { return hits; }
+
+    void clear() { table.clear(); generations.clear(); hits = 0; }
+};
+
+/* ------------------- Flat AST: post-order node array ------------------- */
+/* The same trees as one array of fixed-size nodes in post-order: children
+ *   come before their parent and refer to each other by index, and each
+ *   statement's nodes are contiguous with its root last. Passes iterate the
+ *   array front to back instead of chasing pointers, and the stack code for
+ *   a statement is simply its nodes in order. */
+enum class FlatKind : uint8_t {
+    Number,    // a: index into numbers, of the node's type
+    Variable,  // a: Symbol
+    Binary,    // a, b: lhs and rhs nodes
+    Assign,    // a: value node, b: Symbol
+    Print,     // a: value node
+};
+
+struct FlatNode {
+    FlatKind kind;
+    char op = 0;      // Binary
+    Type type = Type::Float;  // as Expr::type
+    uint32_t pos = 0; // as Expr::pos
+    uint32_t a = 0, b = 0;
+};
+
+struct FlatAst {
+    vector<FlatNode> nodes;
+    vector<uint32_t> stmtEnd;     // statement i is nodes [stmtEnd[i-1], stmtEnd[i])
+    vector<Value> numbers;
+
+    size_t statements() const { return stmtEnd.size(); }
+    uint32_t stmtBegin(size_t i) const { return i ? stmtEnd[i - 1] : 0; }
+    const FlatNode &root(size_t i) const { return nodes[stmtEnd[i] - 1]; }
+
+    size_t bytes() const {
+        return nodes.capacity() * sizeof(FlatNode) + stmtEnd.capacity() * sizeof(uint32_t)
+             + numbers.capacity() * sizeof(Value);
+    }
 };
 
-/* ------------------- Parser (recursive descent) ------------------- */
-class Parser {
-    vector<Token> toks;
+// Lays out parsed statements as a FlatAst.
+FlatAst flatten(const vector<Expr*> &prog) {
+    FlatAst out;
+    vector<uint32_t> done;  // finished subtrees not yet claimed by a parent
+    auto pop = [&] { uint32_t i = done.back(); done.pop_back(); return i; };
+    for (const Expr *stmt : prog) {
+        walkPostorder(stmt, [&](const Expr *e) {
+            FlatNode n = visitExpr(*e, ast::Overloaded{
+                [&](const NumberExpr &num) {
+                    out.numbers.push_back(num.value);
+                    return FlatNode{.kind = FlatKind::Number, .a = uint32_t(out.numbers.size() - 1)};
+                },
+                [&](const VariableExpr &v) { return FlatNode{.kind = FlatKind::Variable, .a = v.sym}; },
+                [&](const BinaryExpr &bin) {
+                    uint32_t rhs = pop(), lhs = pop();
+                    return FlatNode{.kind = FlatKind::Binary, .op = bin.op, .a = lhs, .b = rhs};
+                },
+                [&](const AssignExpr &as) { return FlatNode{.kind = FlatKind::Assign, .a = pop(), .b = as.sym}; },
+                [&](const PrintExpr&) { return FlatNode{.kind = FlatKind::Print, .a = pop()}; },
+            });
+            n.type = e->type;
+            n.pos = e->pos;
+            done.push_back(uint32_t(out.nodes.size()));
+            out.nodes.push_back(n);
+        });
+        done.clear();
+        out.stmtEnd.push_back(uint32_t(out.nodes.size()));
+    }
+    out.nodes.shrink_to_fit();
+    out.stmtEnd.shrink_to_fit();
+    out.numbers.shrink_to_fit();
+    return out;
+}
+
+/* ------------------- Parser (statements by descent, expressions by operator stack) ------------------- */
+// Binary operators; see op_table.hpp.
+static constexpr auto kOps = parse::make_op_table<TokenKind>({
+    {TokenKind::Plus, '+', 1}, {TokenKind::Minus, '-', 1},
+    {TokenKind::Star, '*', 2}, {TokenKind::Slash, '/', 2},
+});
+
+// Prefix minus is 0 - x; an int64 0, so -x has the type of x.
+static constexpr Literal kZero{Value::ofInt(0), Type::Int};
+
+// Position in a token stream, shared by Parser and DirectCompiler.
+class TokenCursor {
+protected:
+    const TokenStream &toks;
     size_t pos = 0;
+
+    explicit TokenCursor(const TokenStream &t): toks(t) {}
 public:
-    Parser(vector<Token> t): toks(move(t)), pos(0) {}
-    Token& peek() {
-        if (pos >= toks.size()) throw runtime_error("Parser: unexpected end");
-        return toks[pos];
+    TokenKind peek() {
+        if (pos >= toks.size()) throw SourceError(uint32_t(toks.source().size()), "Parser: unexpected end");
+        return toks.kind(pos);
     }
-    Token get() {
-        if (pos >= toks.size()) throw runtime_error("Parser: unexpected end");
-        return toks[pos++];
+    TokenRef get() {
+        if (pos >= toks.size()) throw SourceError(uint32_t(toks.source().size()), "Parser: unexpected end");
+        return {&toks, pos++};
     }
     bool accept(TokenKind k) {
-        if (pos < toks.size() && toks[pos].kind == k) { pos++; return true; }
+        if (pos < toks.size() && toks.kind(pos) == k) { pos++; return true; }
         return false;
     }
-    vector<unique_ptr<Expr>> parseProgram() {
-        vector<unique_ptr<Expr>> out;
-        while (pos < toks.size() && peek().kind != TokenKind::End) {
-            auto s = parseStatement();
-            out.push_back(move(s));
 
-            // Require semicolon after each statement
-            if (!accept(TokenKind::Semicolon) && peek().kind != TokenKind::End) {
-                throw runtime_error("Parser: expected ';' after statement");
-            }
+    // Starts over at the first token, for a stream the caller has refilled.
+    void rewind() { pos = 0; }
 
-        }
-        return out;
+protected:
+    // Offset of the next token, for errors about what was expected there.
+    uint32_t here() const {
+        return pos < toks.size() ? toks.offset(pos) : uint32_t(toks.source().size());
+    }
+
+    // Infix operator at pos, or one with lbp 0 when there is none.
+    parse::Infix nextOp() const {
+        return pos < toks.size() ? kOps[toks.kind(pos)] : parse::Infix{};
+    }
+
+    // Identifier '=' at pos: an assignment statement.
+    bool atAssignment() const {
+        return pos + 1 < toks.size() && toks.kind(pos) == TokenKind::Identifier && toks.kind(pos + 1) == TokenKind::Assign;
     }
+};
 
+class Parser : public TokenCursor {
+    Arena &arena;
+    HashCons *cons;  // set: share identical subexpressions (a DAG)
+public:
+    Parser(const TokenStream &t, Arena &a, HashCons *hc = nullptr): TokenCursor(t), arena(a), cons(hc) {}
+    vector<Expr*> parseProgram() {
+        vector<Expr*> out;
+        while (Expr *s = parseNext()) out.push_back(s);
+        return out;
+    }
 
+    // Next statement and its ';', or null at the end of the tokens.
+    Expr *parseNext() {
+        if (pos >= toks.size() || peek() == TokenKind::End) return nullptr;
+        auto s = parseStatement();
 
+        // Require semicolon after each statement
+        if (!accept(TokenKind::Semicolon) && peek() != TokenKind::End) {
+            throw SourceError(here(), "Parser: expected ';' after statement");
+        }
+        return s;
+    }
 
 private:
-    unique_ptr<Expr> parseStatement() {
+    template <class T, class... Args>
+    Expr *node(uint32_t at, Args&&... args) {
+        T *e = arena.make<T>(forward<Args>(args)...);
+        e->pos = at;
+        return e;
+    }
+
+    // The nodes hash-consing may share.
+    Expr *number(uint32_t at, Literal l) {
+        auto make = [&] { return node<NumberExpr>(at, l); };
+        return cons ? cons->number(l, make) : make();
+    }
+    Expr *variable(uint32_t at, Symbol sym) {
+        auto make = [&] { return node<VariableExpr>(at, sym); };
+        return cons ? cons->variable(sym, make) : make();
+    }
+    Expr *binary(uint32_t at, char op, Expr *l, Expr *r) {
+        auto make = [&] { return node<BinaryExpr>(at, op, l, r); };
+        return cons ? cons->binary(op, l, r, make) : make();
+    }
+
+    Expr *parseStatement() {
         if (pos < toks.size()) {
-            if (peek().kind == TokenKind::KeywordPrint) {
-                get(); // consume 'print'
+            if (peek() == TokenKind::KeywordPrint) {
+                uint32_t at = get().offset(); // consume 'print'
                 // allow: print ( <expr> )  or print <expr>
                 if (accept(TokenKind::LParen)) {
                     auto e = parseExpression();
-                    if (!accept(TokenKind::RParen)) throw runtime_error("Parser: expected ')'");
-                    return make_unique<PrintExpr>(move(e));
+                    if (!accept(TokenKind::RParen)) throw SourceError(here(), "Parser: expected ')'");
+                    return node<PrintExpr>(at, e);
                 } else {
                     auto e = parseExpression();
-                    return make_unique<PrintExpr>(move(e));
+                    return node<PrintExpr>(at, e);
                 }
             }
             // assignment: Identifier '=' expression
-            if (peek().kind == TokenKind::Identifier) {
-                // lookahead
-                Token id = toks[pos];
-                if (pos + 1 < toks.size() && toks[pos+1].kind == TokenKind::Assign) {
-                    pos++; // consume id
-                    pos++; // consume =
-                    auto rhs = parseExpression();
-                    return make_unique<AssignExpr>(id.text, move(rhs));
-                }
+            if (atAssignment()) {
+                TokenRef id{&toks, pos};
+                pos += 2; // consume id and =
+                auto rhs = parseExpression();
+                if (cons) cons->assigned(id.symbol());
+                return node<AssignExpr>(id.offset(), id.symbol(), rhs);
             }
         }
         return parseExpression();
     }
 
-    unique_ptr<Expr> parseExpression() {
-        auto left = parseTerm();
-        while (pos < toks.size() && (peek().kind == TokenKind::Plus || peek().kind == TokenKind::Minus)) {
-            char op = get().text[0];
-            auto right = parseTerm();
-            left = make_unique<BinaryExpr>(op, move(left), move(right));
+    /* Expressions are parsed without recursion, so nesting depth is bounded
+     *   by memory and not by the C stack. Operands wait on `vals`; prefix
+     *   minus, '(' and binary operators still missing an operand wait on
+     *   `ops`. An operator reduces the binary operators under it that bind
+     *   at least as tightly (kOps binding powers, as in precedence climbing),
+     *   and unary minus applies as soon as its operand is complete. */
+    struct PendingOp {
+        enum Kind : uint8_t { Negate, Paren, Binary } kind;
+        parse::Infix infix;  // Binary only
+        uint32_t at;
+    };
+    vector<PendingOp> ops;
+    vector<Expr*> vals;
+
+    void reduce() {
+        PendingOp op = ops.back();
+        ops.pop_back();
+        Expr *rhs = vals.back();
+        if (op.kind == PendingOp::Negate) {
+            vals.back() = binary(op.at, '-', number(op.at, kZero), rhs);
+            return;
         }
-        return left;
+        vals.pop_back();
+        vals.back() = binary(op.at, op.infix.op, vals.back(), rhs);
     }
 
-    unique_ptr<Expr> parseTerm() {
-        auto left = parseFactor();
-        while (pos < toks.size() && (peek().kind == TokenKind::Star || peek().kind == TokenKind::Slash)) {
-            char op = get().text[0];
-            auto right = parseFactor();
-            left = make_unique<BinaryExpr>(op, move(left), move(right));
-        }
-        return left;
+    void reduceNegations() {
+        while (!ops.empty() && ops.back().kind == PendingOp::Negate) reduce();
     }
 
-    unique_ptr<Expr> parseFactor() {
-        // Support unary minus here
-        if (peek().kind == TokenKind::Minus) {
-            get(); // consume '-'
-            auto operand = parseFactor();
-            return make_unique<BinaryExpr>('-', make_unique<NumberExpr>(0.0), move(operand));
-        }
+    // Reduces binary operators that bind at least as tightly as lbp (all of
+    // them for lbp 0), stopping at the innermost '('.
+    void reduceBinaries(uint8_t lbp) {
+        while (!ops.empty() && ops.back().kind == PendingOp::Binary && ops.back().infix.rbp >= lbp) reduce();
+    }
 
-        Token t = get();
-        if (t.kind == TokenKind::Number) {
-            return make_unique<NumberExpr>(t.number);
-        } else if (t.kind == TokenKind::Identifier) {
-            return make_unique<VariableExpr>(t.text);
-        } else if (t.kind == TokenKind::LParen) {
-            auto e = parseExpression();
-            if (!accept(TokenKind::RParen)) throw runtime_error("Parser: expected ')'");
-            return e;
+    Expr *parseExpression() {
+        ops.clear();
+        vals.clear();
+        size_t open = 0;  // '(' on ops
+        while (true) {
+            // Operand: any prefix minus / '(' first.
+            for (TokenKind k = peek(); k == TokenKind::Minus || k == TokenKind::LParen; k = peek()) {
+                ops.push_back({k == TokenKind::Minus ? PendingOp::Negate : PendingOp::Paren, {}, get().offset()});
+                open += k == TokenKind::LParen;
+            }
+            TokenRef t = get();
+            if (t.kind() == TokenKind::Number) {
+                vals.push_back(number(t.offset(), t.number()));
+            } else if (t.kind() == TokenKind::Identifier) {
+                vals.push_back(variable(t.offset(), t.symbol()));
+            } else {
+                throw SourceError(t.offset(), "Parser: unexpected token '" + string(t.text()) + "'");
+            }
+            reduceNegations();
+
+            // Closing parens finish operands of their own.
+            while (open > 0 && accept(TokenKind::RParen)) {
+                reduceBinaries(0);
+                ops.pop_back();  // the '('
+                --open;
+                reduceNegations();
+            }
+
+            parse::Infix op = nextOp();
+            if (op.lbp == 0) break;
+            reduceBinaries(op.lbp);
+            ops.push_back({PendingOp::Binary, op, toks.offset(pos++)});
         }
-        throw runtime_error(string("Parser: unexpected token '") + t.text + "'");
+        if (open > 0) throw SourceError(here(), "Parser: expected ')'");
+        reduceBinaries(0);
+        Expr *e = vals.back();
+        vals.pop_back();
+        return e;
     }
 };
 
-/* ------------------- Semantic Analyzer ------------------- */
-/* Very small pass: track which variables were assigned (declared) so far.
- *   Warnings are printed for use-before-assignment. Assignments "declare" variable. */
-class SemanticAnalyzer {
-    unordered_set<string> assigned;
-    vector<string> warnings;
-    vector<string> errors;
+/* ------------------- Incremental front end: relex / reparse edits ------------------- */
+/* Holds a program as a list of statements, each with its own text, tokens
+ *   and tree, for editor-like callers that change a few bytes of a large
+ *   program at a time. edit() relexes and reparses only the statements the
+ *   edited range touches; every other statement keeps its tokens and tree.
+ *
+ *   A statement's text runs from just after the previous ';' through its
+ *   own ';' (the last one may have none). No token spans a ';', so each
+ *   statement lexes on its own and its token offsets and node positions are
+ *   relative to its text; start(i) gives the absolute offset. When an edit
+ *   removes or adds a ';', the following statement is absorbed and the
+ *   merged text is split again.
+ *
+ *   Replaced trees stay in the arena until they outnumber the live ones;
+ *   then the kept token streams are reparsed into a fresh arena, so edits
+ *   stay amortized proportional to the statements they touch. */
+class IncrementalFrontend {
 public:
-    void analyzeProgram(const vector<unique_ptr<Expr>>& prog) {
-        assigned.clear(); warnings.clear(); errors.clear();
-        for (const auto &s : prog) analyzeStmt(s.get());
+    struct Statement {
+        string text;
+        TokenStream toks;     // over text, ending with End
+        Expr *root = nullptr; // null when text is blank or has an error
+        string error;         // lexer or parser message; empty if none
+        uint32_t errorAt = 0; // offset in text
+        size_t nodes = 0;     // arena nodes built for root
+    };
+
+    explicit IncrementalFrontend(string_view src) {
+        checkSourceSize(src);
+        stmts = build(src);
+        size_t at = 0;
+        for (auto &s : stmts) {
+            starts.push_back(at);
+            at += s->text.size();
+            live += s->nodes;
+        }
     }
-    const vector<string>& getWarnings() const { return warnings; }
-    const vector<string>& getErrors() const { return errors; }
 
-private:
-    void analyzeExpr(const Expr* e) {
-        if (!e) return;
-        if (auto n = dynamic_cast<const NumberExpr*>(e)) return;
-        if (auto v = dynamic_cast<const VariableExpr*>(e)) {
-            if (assigned.find(v->name) == assigned.end())
-                warnings.push_back("use of variable '" + v->name + "' before assignment");
-            return;
+    // Replaces bytes [begin, end) with `text`.
+    void edit(size_t begin, size_t end, string_view text) {
+        size_t total = size();
+        if (begin > end || end > total) throw out_of_range("IncrementalFrontend: edit outside the source");
+        if (total - (end - begin) + text.size() > numeric_limits<uint32_t>::max()) {
+            throw runtime_error("Lexer: source larger than 4 GiB");
         }
-        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
-            analyzeExpr(b->lhs.get());
-            analyzeExpr(b->rhs.get());
+        if (stmts.empty()) {
+            *this = IncrementalFrontend(text);
+            lastRelexed = stmts.size();
             return;
         }
-        if (auto as = dynamic_cast<const AssignExpr*>(e)) {
-            analyzeExpr(as->value.get());
-            // assignment declares variable afterwards
-            assigned.insert(as->name);
-            return;
+
+        size_t first = statementAt(begin), last = statementAt(end > begin ? end - 1 : begin);
+        string merged = stmts[first]->text.substr(0, begin - starts[first]);
+        merged += text;
+        merged += string_view(stmts[last]->text).substr(end - starts[last]);
+
+        // Text left after the last ';' belongs to the statement that follows.
+        while (last + 1 < stmts.size()) {
+            auto cuts = splitPoints(merged);
+            if (!cuts.empty() && cuts.back() == merged.size()) break;
+            merged += stmts[++last]->text;
         }
-        if (auto p = dynamic_cast<const PrintExpr*>(e)) {
-            analyzeExpr(p->value.get());
-            return;
+
+        size_t oldBytes = 0;
+        for (size_t i = first; i <= last; ++i) {
+            oldBytes += stmts[i]->text.size();
+            live -= stmts[i]->nodes;
+            dead += stmts[i]->nodes;
+        }
+        auto fresh = build(merged);
+
+        vector<size_t> freshStarts;
+        size_t at = starts[first];
+        for (auto &s : fresh) {
+            freshStarts.push_back(at);
+            at += s->text.size();
+            live += s->nodes;
+        }
+        size_t replaced = last + 1 - first;
+        if (fresh.size() == replaced) {
+            // The usual case: no ';' added or removed, nothing to move.
+            move(fresh.begin(), fresh.end(), stmts.begin() + first);
+            copy(freshStarts.begin(), freshStarts.end(), starts.begin() + first);
+        } else {
+            stmts.erase(stmts.begin() + first, stmts.begin() + last + 1);
+            stmts.insert(stmts.begin() + first, make_move_iterator(fresh.begin()), make_move_iterator(fresh.end()));
+            starts.erase(starts.begin() + first, starts.begin() + last + 1);
+            starts.insert(starts.begin() + first, freshStarts.begin(), freshStarts.end());
+        }
+        if (merged.size() != oldBytes) {
+            for (size_t i = first + fresh.size(); i < starts.size(); ++i) starts[i] += merged.size() - oldBytes;
         }
-        errors.push_back("semantic: unknown node");
+        lastRelexed = fresh.size();
+
+        if (dead > live + kMinGarbage) compact();
     }
 
-    void analyzeStmt(const Expr* s) { analyzeExpr(s); }
-};
+    size_t size() const { return stmts.empty() ? 0 : starts.back() + stmts.back()->text.size(); }
+    size_t statementCount() const { return stmts.size(); }
+    const Statement &statement(size_t i) const { return *stmts[i]; }
+    size_t start(size_t i) const { return starts[i]; }
 
-/* ------------------- CodeGen: tiny stack instructions ------------------- */
-enum class OpCode { PUSH_CONST, LOAD_VAR, STORE_VAR, ADD, SUB, MUL, DIV, PRINT };
+    // Statements relexed and reparsed by the last edit.
+    size_t relexedByLastEdit() const { return lastRelexed; }
 
-struct Instr {
-    OpCode op;
-    double val;     // for PUSH_CONST
-    string name;    // for LOAD_VAR / STORE_VAR
-    Instr(OpCode o=OpCode::PUSH_CONST, double v=0.0, string n=""): op(o), val(v), name(move(n)) {}
-};
+    // Roots of the statements that parsed, in source order.
+    vector<Expr*> program() const {
+        vector<Expr*> out;
+        for (auto &s : stmts) if (s->root) out.push_back(s->root);
+        return out;
+    }
 
-class CodeGen {
-    vector<Instr> code;
-public:
-    vector<Instr> generateProgram(const vector<unique_ptr<Expr>>& prog) {
-        code.clear();
-        for (const auto &s : prog) {
-            generateExpr(s.get());
-            // After a statement, we may leave value on stack; PRINT handles printing for print statements.
-            // For expressions/assignments we leave result on stack as well (REPL may print it).
+    // First lexer or parser error, at its absolute offset.
+    optional<Diagnostic> firstError() const {
+        for (size_t i = 0; i < stmts.size(); ++i) {
+            if (!stmts[i]->error.empty()) return Diagnostic{uint32_t(starts[i] + stmts[i]->errorAt), stmts[i]->error};
         }
-        return code;
+        return nullopt;
+    }
+
+    string text() const {
+        string out;
+        out.reserve(size());
+        for (auto &s : stmts) out += s->text;
+        return out;
     }
 
 private:
-    void generateExpr(const Expr* e) {
-        if (!e) return;
-        if (auto n = dynamic_cast<const NumberExpr*>(e)) {
-            code.emplace_back(OpCode::PUSH_CONST, n->value);
-            return;
-        }
-        if (auto v = dynamic_cast<const VariableExpr*>(e)) {
-            code.emplace_back(OpCode::LOAD_VAR, 0.0, v->name);
-            return;
+    static constexpr size_t kMinGarbage = 1 << 16;  // nodes
+
+    vector<unique_ptr<Statement>> stmts;  // boxed: names view each text
+    vector<size_t> starts;
+    unique_ptr<Arena> arena = make_unique<Arena>();
+    size_t live = 0, dead = 0;  // arena nodes reachable / replaced
+    size_t lastRelexed = 0;
+
+    size_t statementAt(size_t offset) const {
+        size_t i = upper_bound(starts.begin(), starts.end(), offset) - starts.begin();
+        return i ? i - 1 : 0;
+    }
+
+    // Offsets just past each ';' token.
+    static vector<size_t> splitPoints(string_view src) {
+        vector<size_t> cuts;
+        Lexer lx(src, false);
+        while (true) {
+            Token t;
+            try {
+                t = lx.next();
+            } catch (const SourceError&) {
+                continue;  // a bad literal; the statement reports it when relexed
+            }
+            if (t.kind == TokenKind::End) break;
+            if (t.kind == TokenKind::Semicolon) cuts.push_back(t.offset + 1);
         }
-        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
-            generateExpr(b->lhs.get());
-            generateExpr(b->rhs.get());
-            switch (b->op) {
-                case '+': code.emplace_back(OpCode::ADD); break;
-                case '-': code.emplace_back(OpCode::SUB); break;
-                case '*': code.emplace_back(OpCode::MUL); break;
-                case '/': code.emplace_back(OpCode::DIV); break;
-                default: throw runtime_error("CodeGen: unknown op");
+        return cuts;
+    }
+
+    vector<unique_ptr<Statement>> build(string_view src) {
+        vector<unique_ptr<Statement>> out;
+        auto cuts = splitPoints(src);
+        if (cuts.empty() || cuts.back() != src.size()) cuts.push_back(src.size());
+        size_t from = 0;
+        for (size_t cut : cuts) {
+            if (cut == from) continue;
+            auto s = make_unique<Statement>();
+            s->text = src.substr(from, cut - from);
+            try {
+                s->toks = tokenize(s->text);
+            } catch (const SourceError &e) {
+                s->error = e.what();
+                s->errorAt = e.offset;
             }
-            return;
+            if (s->error.empty()) parse(*s);
+            out.push_back(move(s));
+            from = cut;
         }
-        if (auto a = dynamic_cast<const AssignExpr*>(e)) {
-            generateExpr(a->value.get());
-            code.emplace_back(OpCode::STORE_VAR, 0.0, a->name);
-            return;
+        return out;
+    }
+
+    void parse(Statement &s) {
+        size_t before = arena->allocations();
+        try {
+            auto prog = Parser(s.toks, *arena).parseProgram();
+            s.root = prog.empty() ? nullptr : prog[0];
+        } catch (const SourceError &e) {
+            s.root = nullptr;
+            s.error = e.what();
+            s.errorAt = e.offset;
         }
-        if (auto p = dynamic_cast<const PrintExpr*>(e)) {
-            generateExpr(p->value.get());
-            code.emplace_back(OpCode::PRINT);
-            return;
+        s.nodes = arena->allocations() - before;
+    }
+
+    // Reparses every statement that lexed into a fresh arena.
+    void compact() {
+        arena = make_unique<Arena>();
+        live = dead = 0;
+        for (auto &s : stmts) {
+            if (s->toks.empty()) continue;
+            s->error.clear();
+            parse(*s);
+            live += s->nodes;
         }
-        throw runtime_error("CodeGen: unknown node");
     }
 };
 
-/* ------------------- VM: executes instruction vector ------------------- */
-class VM {
-    vector<double> stack;
-    unordered_map<string,double> vars;
+/* ------------------- Semantic Analyzer ------------------- */
+class VM;
+
+/* Tracks which variables are assigned, and infers types: each variable's
+ *   from the values assigned to it so far, and each node's value type
+ *   (Expr::type) for CodeGen. Assigning a double to an int64 variable
+ *   makes it a double from there on; assigning an int64 to a double one
+ *   converts the value. Statements are analyzed in the order they run, so
+ *   each read has the type the variable holds when it runs.
+ *
+ *   analyzeProgram starts over; analyzeNext continues the session so far
+ *   (REPL lines, Pipeline statements), so variables earlier statements
+ *   defined stay defined and each call costs only the new code. An
+ *   assignment counts once it is analyzed, before it runs; settle() then
+ *   withdraws those the VM did not carry out, so later warnings and types
+ *   match the variables the VM holds. */
+class SemanticAnalyzer {
+    vector<uint8_t> vars;  // by Symbol: 0 unassigned, else 1 + its Type
+    vector<Symbol> unsettled;  // assigned or widened since the last settle()
+    vector<Diagnostic> warnings;
+    vector<Diagnostic> errors;
 public:
-    VM() = default;
+    void analyzeProgram(const vector<Expr*>& prog) {
+        reset();
+        for (const Expr *s : prog) analyzeStmt(s);
+    }
+    // More statements of the session; diagnostics are those of these
+    // statements only.
+    void analyzeNext(const vector<Expr*>& stmts) {
+        clearDiagnostics();
+        for (const Expr *s : stmts) analyzeStmt(s);
+    }
+    void analyzeNext(const Expr *s) {
+        clearDiagnostics();
+        analyzeStmt(s);
+    }
+    // Same diagnostics as for the tree, in one pass over the nodes.
+    void analyzeProgram(const FlatAst &ast) {
+        reset();
+        for (const FlatNode &n : ast.nodes) {
+            if (n.kind == FlatKind::Variable) use(n.a, n.pos);
+            else if (n.kind == FlatKind::Assign) assign(n.b, ast.nodes[n.a].type);
+        }
+    }
 
-    double execSingle(const vector<Instr>& code) {
-        stack.clear();
-        for (size_t ip=0; ip<code.size(); ++ip) {
-            const Instr &ins = code[ip];
-            switch (ins.op) {
-                case OpCode::PUSH_CONST:
-                    stack.push_back(ins.val);
-                    break;
-                case OpCode::LOAD_VAR: {
-                    auto it = vars.find(ins.name);
-                    if (it == vars.end()) throw runtime_error("VM: undefined variable '" + ins.name + "'");
-                    stack.push_back(it->second);
-                } break;
-                case OpCode::STORE_VAR: {
-                    if (stack.empty()) throw runtime_error("VM: store with empty stack");
-                    double v = stack.back(); stack.pop_back();
-                    vars[ins.name] = v;
-                    // push value back so caller can view result if needed
-                    stack.push_back(v);
-                } break;
-                case OpCode::ADD: {
-                    if (stack.size() < 2) throw runtime_error("VM: stack underflow ADD");
-                    double r = stack.back(); stack.pop_back();
-                    double l = stack.back(); stack.pop_back();
-                    stack.push_back(l + r);
-                } break;
-                case OpCode::SUB: {
-                    if (stack.size() < 2) throw runtime_error("VM: stack underflow SUB");
-                    double r = stack.back(); stack.pop_back();
-                    double l = stack.back(); stack.pop_back();
-                    stack.push_back(l - r);
-                } break;
-                case OpCode::MUL: {
-                    if (stack.size() < 2) throw runtime_error("VM: stack underflow MUL");
-                    double r = stack.back(); stack.pop_back();
-                    double l = stack.back(); stack.pop_back();
-                    stack.push_back(l * r);
-                } break;
-                case OpCode::DIV: {
-                    if (stack.size() < 2) throw runtime_error("VM: stack underflow DIV");
-                    double r = stack.back(); stack.pop_back();
-                    double l = stack.back(); stack.pop_back();
-                    if (r == 0.0) throw runtime_error("VM: division by zero");
-                    stack.push_back(l / r);
-                } break;
-                case OpCode::PRINT: {
-                    if (stack.empty()) throw runtime_error("VM: stack underflow PRINT");
-                    double v = stack.back(); stack.pop_back();
-                    // print nicely
-                    cout.setf(std::ios::fmtflags(0), ios::floatfield);
-                    cout << v << "\n";
-                } break;
-                default:
-                    throw runtime_error("VM: unknown opcode");
-            }
+    /* For compilers that analyze as they go (DirectCompiler), in the order
+     *   the tree would be visited: the type of variable sym read at pos,
+     *   and the type it has once assigned a value of type t. */
+    Type use(Symbol sym, uint32_t pos) {
+        if (sym < vars.size() && vars[sym]) return Type(vars[sym] - 1);
+        warnings.push_back({pos, "use of variable '" + string(symbols().name(sym)) + "' before assignment"});
+        // Never loaded: the VM stops at the undefined variable. As an int64
+        // it widens nothing it is combined with or assigned to.
+        return Type::Int;
+    }
+    Type assign(Symbol sym, Type t) {
+        if (sym >= vars.size()) vars.resize(symbols().size());
+        if (vars[sym]) t = join(Type(vars[sym] - 1), t);
+        if (vars[sym] != 1 + uint8_t(t)) {
+            vars[sym] = 1 + uint8_t(t);
+            unsettled.push_back(sym);
         }
-        if (stack.empty()) return 0.0;
-        return stack.back();
+        return t;
     }
+    void clearDiagnostics() { warnings.clear(); errors.clear(); }
 
-    optional<double> getVar(const string &name) const {
-        auto it = vars.find(name);
-        if (it == vars.end()) return nullopt;
-        return it->second;
+    // Call once the analyzed statements have run or failed.
+    void settle(const VM &vm);  // after VM
+
+    const vector<Diagnostic>& getWarnings() const { return warnings; }
+    const vector<Diagnostic>& getErrors() const { return errors; }
+
+private:
+    void reset() {
+        vars.clear(); unsettled.clear(); clearDiagnostics();
+    }
+
+    void analyzeExpr(const Expr* root) {
+        walkPostorder(root, [&](const Expr *e) {
+            visitExpr(*e, ast::Overloaded{
+                [](const NumberExpr&) {},  // typed by its literal
+                [&](const VariableExpr &v) { v.type = use(v.sym, v.pos); },
+                [&](const BinaryExpr &b) { b.type = binaryType(b.op, b.lhs->type, b.rhs->type); },
+                // assignment declares variable after its value is analyzed
+                [&](const AssignExpr &as) { as.type = assign(as.sym, as.value->type); },
+                [&](const PrintExpr &p) { p.type = p.value->type; },
+            });
+        });
     }
 
-    void setVar(const string &name, double v) { vars[name] = v; }
+    void analyzeStmt(const Expr* s) { analyzeExpr(s); }
 };
 
-/* ------------------- Small helper to generate per-statement code ------------------- */
-vector<Instr> genForStmt(const unique_ptr<Expr>& stmt) {
-    vector<Instr> out;
-    function<void(const Expr*)> gen = [&](const Expr* e) {
-        if (!e) return;
-        if (auto n = dynamic_cast<const NumberExpr*>(e)) {
-            out.emplace_back(OpCode::PUSH_CONST, n->value);
-            return;
+/* ------------------- Constant pool ------------------- */
+/* Literal values shared by every statement of a session. Equal constants are
+ *   stored once and instructions refer to them by index. Constants are
+ *   untyped cells like every Value, so an int64 and a double with the same
+ *   bits share an entry. */
+class ConstPool {
+    vector<Value> values;
+    unordered_map<uint64_t, uint32_t> index;  // keyed by bit pattern
+public:
+    uint32_t intern(Value v) {
+        auto [it, inserted] = index.try_emplace(v.bits, (uint32_t)values.size());
+        if (inserted) values.push_back(v);
+        return it->second;
+    }
+    Value operator[](uint32_t i) const { return values[i]; }
+    const Value *data() const { return values.data(); }
+    size_t size() const { return values.size(); }
+    void clear() { values.clear(); index.clear(); }
+};
+
+/* ------------------- CodeGen: tiny stack instructions ------------------- */
+/* Variables live in frame slots. A variable's slot is its Symbol, resolved
+ *   once when the lexer interns the name: ids are dense and the symbol table
+ *   outlives every statement, so a slot keeps its value across REPL lines
+ *   and the VM indexes a flat frame instead of searching for names. */
+/* Arithmetic is typed: I* opcodes work on int64 cells and F* on double
+ *   ones, and CodeGen converts an int64 operand of a double operator first
+ *   (I2F for the top of the stack, I2F_LHS for the value under it), so the
+ *   VM never looks at a value's type. Int64 operators stop with an error on
+ *   overflow instead of wrapping. Stores are typed too: the VM records the
+ *   type each slot holds, for SemanticAnalyzer::settle. */
+enum class OpCode {
+    PUSH_CONST, LOAD_SLOT, ISTORE_SLOT, FSTORE_SLOT,
+    IADD, ISUB, IMUL, FADD, FSUB, FMUL, FDIV, I2F, I2F_LHS,
+    IPRINT, FPRINT, SAVE_TMP, LOAD_TMP
+};
+
+struct Instr {
+    OpCode op;
+    uint32_t arg;   // PUSH_CONST: constant pool index; LOAD_SLOT / *STORE_SLOT: slot (Symbol);
+                    // SAVE_TMP / LOAD_TMP: temporary
+    uint32_t pos;   // source offset, for runtime errors
+    Instr(OpCode o=OpCode::PUSH_CONST, uint32_t a=0, uint32_t p=0): op(o), arg(a), pos(p) {}
+};
+
+// Appends binary operator op on operands of types lhs and rhs; pos places
+// overflow and division by zero.
+static void emitBinary(char op, Type lhs, Type rhs, uint32_t pos, vector<Instr> &out) {
+    bool isInt = binaryType(op, lhs, rhs) == Type::Int;
+    if (!isInt && lhs == Type::Int) out.emplace_back(OpCode::I2F_LHS);
+    if (!isInt && rhs == Type::Int) out.emplace_back(OpCode::I2F);
+    switch (op) {
+        case '+': out.emplace_back(isInt ? OpCode::IADD : OpCode::FADD, 0, pos); break;
+        case '-': out.emplace_back(isInt ? OpCode::ISUB : OpCode::FSUB, 0, pos); break;
+        case '*': out.emplace_back(isInt ? OpCode::IMUL : OpCode::FMUL, 0, pos); break;
+        case '/': out.emplace_back(OpCode::FDIV, 0, pos); break;
+        default: throw runtime_error("CodeGen: unknown op");
+    }
+}
+
+// Appends the store of a value of type value into slot sym of type var.
+static void emitStore(Symbol sym, Type var, Type value, vector<Instr> &out) {
+    if (var == Type::Float && value == Type::Int) out.emplace_back(OpCode::I2F);
+    out.emplace_back(var == Type::Int ? OpCode::ISTORE_SLOT : OpCode::FSTORE_SLOT, sym);
+}
+
+static void emitPrint(Type value, vector<Instr> &out) {
+    out.emplace_back(value == Type::Int ? OpCode::IPRINT : OpCode::FPRINT);
+}
+
+// Appends the code for nodes [from, to) of ast: the nodes in order, one
+// instruction each plus any conversions.
+static void emitFlat(const FlatAst &ast, uint32_t from, uint32_t to, ConstPool &pool, vector<Instr> &out) {
+    for (uint32_t i = from; i < to; ++i) {
+        const FlatNode &n = ast.nodes[i];
+        switch (n.kind) {
+            case FlatKind::Number: out.emplace_back(OpCode::PUSH_CONST, pool.intern(ast.numbers[n.a])); break;
+            case FlatKind::Variable: out.emplace_back(OpCode::LOAD_SLOT, n.a, n.pos); break;
+            case FlatKind::Binary: emitBinary(n.op, ast.nodes[n.a].type, ast.nodes[n.b].type, n.pos, out); break;
+            case FlatKind::Assign: emitStore(n.b, n.type, ast.nodes[n.a].type, out); break;
+            case FlatKind::Print: emitPrint(ast.nodes[n.a].type, out); break;
         }
-        if (auto v = dynamic_cast<const VariableExpr*>(e)) {
-            out.emplace_back(OpCode::LOAD_VAR, 0.0, v->name);
-            return;
+    }
+}
+
+/* Appends stack code for the statement under root. A shared node (see
+ *   HashCons) is computed once per statement: its first occurrence copies
+ *   the result to a temporary with SAVE_TMP and later ones LOAD_TMP it
+ *   instead of recomputing the subtree. That is sound within a statement,
+ *   whose variables cannot change before it ends; temporaries are not
+ *   reused across statements. Leaves are cheaper to reload than to save. */
+static void emitExpr(const Expr *root, ConstPool &pool, vector<Instr> &out) {
+    size_t first = out.size();
+    unordered_map<const Expr*, uint32_t> temps;
+    vector<uint32_t> loads;  // per temporary
+    auto enter = [&](const Expr *e) {
+        if (!e->shared) return true;
+        auto it = temps.find(e);
+        if (it == temps.end()) return true;
+        out.emplace_back(OpCode::LOAD_TMP, it->second);
+        ++loads[it->second];
+        return false;
+    };
+    walkPostorder(root, [&](const Expr *e) {
+        visitExpr(*e, ast::Overloaded{
+            [&](const NumberExpr &n) { out.emplace_back(OpCode::PUSH_CONST, pool.intern(n.value)); },
+            [&](const VariableExpr &v) { out.emplace_back(OpCode::LOAD_SLOT, v.sym, v.pos); },
+            [&](const BinaryExpr &b) {
+                emitBinary(b.op, b.lhs->type, b.rhs->type, b.pos, out);
+                if (b.shared) {
+                    uint32_t t = uint32_t(loads.size());
+                    temps.emplace(&b, t);
+                    loads.push_back(0);
+                    out.emplace_back(OpCode::SAVE_TMP, t);
+                }
+            },
+            [&](const AssignExpr &a) { emitStore(a.sym, a.type, a.value->type, out); },
+            [&](const PrintExpr &p) { emitPrint(p.value->type, out); },
+        });
+    }, enter);
+
+    // Nodes shared with other statements only were saved for nothing.
+    if (!loads.empty()) {
+        out.erase(remove_if(out.begin() + first, out.end(), [&](const Instr &i) {
+            return i.op == OpCode::SAVE_TMP && loads[i.arg] == 0;
+        }), out.end());
+    }
+}
+
+/* ------------------- Register code: three-address instructions ------------------- */
+/* The alternative backend (--regs): each operator is one instruction that
+ *   names where its operands are and where its result goes, so a*b+c is
+ *   IMUL t0, a, b; IADD t1, t0, c instead of five stack instructions, and
+ *   nothing is pushed or popped. An operand is a frame slot (a variable,
+ *   by Symbol), a temporary of the statement, or a constant pool entry,
+ *   told apart by its top two bits; an assignment's last operator writes
+ *   the variable's slot itself. Types are as for the stack code. */
+enum class RegOp : uint8_t {
+    MOVE, IADD, ISUB, IMUL, FADD, FSUB, FMUL, FDIV, I2F, IPRINT, FPRINT
+};
+
+struct RegInstr {
+    RegOp op;
+    uint32_t dst, a, b;  // operands; IPRINT / FPRINT print a
+    uint32_t pos;        // source offset, for runtime errors
+};
+
+struct RegCode {
+    static constexpr uint32_t kSlot = 0, kTemp = 1u << 30, kConst = 2u << 30, kIndex = kTemp - 1;
+    // A variable read at pos, before instruction at runs (as LOAD_SLOT
+    // would), so the VM can check it was assigned.
+    struct Read { Symbol sym; uint32_t pos, at; };
+    struct Store { Symbol sym; Type type; };
+
+    vector<RegInstr> code;
+    vector<Read> reads;      // in order
+    vector<Store> stores;    // variables assigned, as the types they now hold
+    uint32_t temps = 0;      // temporaries used
+    optional<uint32_t> result;  // operand holding the statement's value, unless it prints
+
+    void clear() { code.clear(); reads.clear(); stores.clear(); temps = 0; result.reset(); }
+};
+
+/* Appends register code for the statement under root. Temporaries are
+ *   reused once the operator consuming them is emitted; a shared node's
+ *   (see HashCons) keeps its temporary to the end of the statement, and
+ *   later occurrences use it instead of recomputing the subtree. An int64
+ *   constant converted for a double operator is converted here. */
+static void emitRegs(const Expr *root, ConstPool &pool, RegCode &rc) {
+    vector<uint32_t> vals;  // operands of the nodes visited, as the stack code's stack
+    vector<uint32_t> freeTemps;
+    vector<char> pinned;  // per temporary: holds a shared node
+    unordered_map<const Expr*, uint32_t> shared;
+    auto isTemp = [](uint32_t x) { return (x & ~RegCode::kIndex) == RegCode::kTemp; };
+    auto temp = [&] {
+        if (freeTemps.empty()) {
+            pinned.push_back(0);
+            return RegCode::kTemp | rc.temps++;
+        }
+        uint32_t t = freeTemps.back();
+        freeTemps.pop_back();
+        return t;
+    };
+    auto release = [&](uint32_t x) {
+        if (isTemp(x) && !pinned[x & RegCode::kIndex]) freeTemps.push_back(x);
+    };
+    auto pop = [&] {
+        uint32_t x = vals.back();
+        vals.pop_back();
+        return x;
+    };
+    // Operand x of type t as a double.
+    auto asFloat = [&](uint32_t x, Type t) {
+        if (t == Type::Float) return x;
+        if ((x & ~RegCode::kIndex) == RegCode::kConst)
+            return RegCode::kConst | pool.intern(Value::ofFloat(double(pool[x & RegCode::kIndex].i())));
+        release(x);
+        uint32_t d = temp();
+        rc.code.push_back({RegOp::I2F, d, x, 0, 0});
+        return d;
+    };
+    auto enter = [&](const Expr *e) {
+        if (!e->shared) return true;
+        auto it = shared.find(e);
+        if (it == shared.end()) return true;
+        vals.push_back(it->second);
+        return false;
+    };
+    walkPostorder(root, [&](const Expr *e) {
+        visitExpr(*e, ast::Overloaded{
+            [&](const NumberExpr &n) { vals.push_back(RegCode::kConst | pool.intern(n.value)); },
+            [&](const VariableExpr &v) {
+                rc.reads.push_back({v.sym, v.pos, uint32_t(rc.code.size())});
+                vals.push_back(RegCode::kSlot | v.sym);
+            },
+            [&](const BinaryExpr &b) {
+                uint32_t r = pop(), l = pop();
+                bool isInt = b.type == Type::Int;
+                if (!isInt) {
+                    l = asFloat(l, b.lhs->type);
+                    r = asFloat(r, b.rhs->type);
+                }
+                release(l);
+                release(r);
+                uint32_t d = temp();
+                if (b.shared) {
+                    pinned[d & RegCode::kIndex] = 1;
+                    shared.emplace(&b, d);
+                }
+                RegOp op;
+                switch (b.op) {
+                    case '+': op = isInt ? RegOp::IADD : RegOp::FADD; break;
+                    case '-': op = isInt ? RegOp::ISUB : RegOp::FSUB; break;
+                    case '*': op = isInt ? RegOp::IMUL : RegOp::FMUL; break;
+                    case '/': op = RegOp::FDIV; break;
+                    default: throw runtime_error("CodeGen: unknown op");
+                }
+                rc.code.push_back({op, d, l, r, b.pos});
+                vals.push_back(d);
+            },
+            [&](const AssignExpr &a) {
+                uint32_t v = pop(), slot = RegCode::kSlot | a.sym;
+                bool convert = a.type == Type::Float && a.value->type == Type::Int;
+                if (convert && (v & ~RegCode::kIndex) != RegCode::kConst) {
+                    rc.code.push_back({RegOp::I2F, slot, v, 0, 0});
+                } else if (convert) {
+                    rc.code.push_back({RegOp::MOVE, slot, asFloat(v, Type::Int), 0, 0});
+                } else if (isTemp(v) && !pinned[v & RegCode::kIndex] && !rc.code.empty() && rc.code.back().dst == v) {
+                    rc.code.back().dst = slot;  // computed straight into the variable
+                } else {
+                    rc.code.push_back({RegOp::MOVE, slot, v, 0, 0});
+                }
+                release(v);
+                rc.stores.push_back({a.sym, a.type});
+                vals.push_back(slot);
+            },
+            [&](const PrintExpr &p) {
+                rc.code.push_back({p.value->type == Type::Int ? RegOp::IPRINT : RegOp::FPRINT, 0, pop(), 0, 0});
+            },
+        });
+    }, enter);
+    if (!vals.empty()) rc.result = vals.back();
+}
+
+class CodeGen {
+    ConstPool &pool;
+    vector<Instr> code;
+public:
+    explicit CodeGen(ConstPool &p): pool(p) {}
+
+    vector<Instr> generateProgram(const vector<Expr*>& prog) {
+        code.clear();
+        for (const Expr *s : prog) {
+            generateExpr(s);
+            // After a statement, we may leave value on stack; PRINT handles printing for print statements.
+            // For expressions/assignments we leave result on stack as well (REPL may print it).
+        }
+        return code;
+    }
+
+    vector<Instr> generateProgram(const FlatAst &ast) {
+        code.clear();
+        emitFlat(ast, 0, uint32_t(ast.nodes.size()), pool, code);
+        return code;
+    }
+
+    // Register code, one RegCode per statement (temporaries and variable
+    // checks are per statement).
+    vector<RegCode> generateRegs(const vector<Expr*>& prog) {
+        vector<RegCode> out(prog.size());
+        for (size_t i = 0; i < prog.size(); ++i) emitRegs(prog[i], pool, out[i]);
+        return out;
+    }
+
+private:
+    void generateExpr(const Expr* root) { emitExpr(root, pool, code); }
+};
+
+/* ------------------- VM: executes instruction vector ------------------- */
+// l op r in int64, or an error at pos when the result does not fit. op is a
+// template argument so each opcode's case compiles to its own code. There is
+// no int64 division: / divides doubles.
+template <char op>
+static int64_t intArith(int64_t l, int64_t r, uint32_t pos) {
+    static_assert(op == '+' || op == '-' || op == '*');
+    int64_t v = 0;
+    bool overflow;
+    if constexpr (op == '+') overflow = __builtin_add_overflow(l, r, &v);
+    else if constexpr (op == '-') overflow = __builtin_sub_overflow(l, r, &v);
+    else overflow = __builtin_mul_overflow(l, r, &v);
+    if (overflow) throw SourceError(pos, "VM: int64 overflow");
+    return v;
+}
+
+template <char op>
+static double floatArith(double l, double r, uint32_t pos) {
+    if constexpr (op == '+') return l + r;
+    else if constexpr (op == '-') return l - r;
+    else if constexpr (op == '*') return l * r;
+    else {
+        if (r == 0.0) throw SourceError(pos, "VM: division by zero");
+        return l / r;
+    }
+}
+
+class VM {
+    const ConstPool &pool;
+    vector<Value> stack;
+    vector<Value> temps;  // SAVE_TMP / LOAD_TMP
+    vector<Value> frame;  // variables, by slot
+    vector<uint8_t> defined;  // per slot: 0 unassigned, else 1 + the Type it holds
+    vector<Value> regs;  // register code temporaries
+public:
+    explicit VM(const ConstPool &p): pool(p) {}
+
+    // Runs code and returns the value it leaves, whose type the code's
+    // compiler knows (0 when it leaves none).
+    Value execSingle(span<const Instr> code) {
+        stack.clear();
+        // Every slot the code can name exists already, so loads and stores
+        // index the frame without bounds checks.
+        if (frame.size() < symbols().size()) {
+            frame.resize(symbols().size());
+            defined.resize(symbols().size());
+        }
+        for (size_t ip=0; ip<code.size(); ++ip) {
+            const Instr &ins = code[ip];
+            switch (ins.op) {
+                case OpCode::PUSH_CONST:
+                    stack.push_back(pool[ins.arg]);
+                    break;
+                case OpCode::LOAD_SLOT:
+                    if (!defined[ins.arg]) throw SourceError(ins.pos, "VM: undefined variable '" + string(symbols().name(ins.arg)) + "'");
+                    stack.push_back(frame[ins.arg]);
+                    break;
+                case OpCode::ISTORE_SLOT:
+                case OpCode::FSTORE_SLOT:
+                    if (stack.empty()) throw runtime_error("VM: store with empty stack");
+                    // the value stays on the stack so caller can view result if needed
+                    frame[ins.arg] = stack.back();
+                    defined[ins.arg] = 1 + uint8_t(ins.op == OpCode::ISTORE_SLOT ? Type::Int : Type::Float);
+                    break;
+                case OpCode::IADD: intOp<'+'>(ins.pos); break;
+                case OpCode::ISUB: intOp<'-'>(ins.pos); break;
+                case OpCode::IMUL: intOp<'*'>(ins.pos); break;
+                case OpCode::FADD: floatOp<'+'>(ins.pos); break;
+                case OpCode::FSUB: floatOp<'-'>(ins.pos); break;
+                case OpCode::FMUL: floatOp<'*'>(ins.pos); break;
+                case OpCode::FDIV: floatOp<'/'>(ins.pos); break;
+                case OpCode::I2F:
+                case OpCode::I2F_LHS: {
+                    size_t depth = ins.op == OpCode::I2F ? 1 : 2;
+                    if (stack.size() < depth) throw runtime_error("VM: stack underflow I2F");
+                    Value &v = stack[stack.size() - depth];
+                    v = Value::ofFloat(double(v.i()));
+                } break;
+                case OpCode::SAVE_TMP:
+                    if (stack.empty()) throw runtime_error("VM: save with empty stack");
+                    if (ins.arg >= temps.size()) temps.resize(ins.arg + 1);
+                    temps[ins.arg] = stack.back();
+                    break;
+                case OpCode::LOAD_TMP:
+                    if (ins.arg >= temps.size()) throw runtime_error("VM: load of unsaved temporary");
+                    stack.push_back(temps[ins.arg]);
+                    break;
+                case OpCode::IPRINT:
+                case OpCode::FPRINT: {
+                    if (stack.empty()) throw runtime_error("VM: stack underflow PRINT");
+                    Value v = stack.back(); stack.pop_back();
+                    printValue(v, ins.op == OpCode::IPRINT ? Type::Int : Type::Float);
+                } break;
+                default:
+                    throw runtime_error("VM: unknown opcode");
+            }
         }
-        if (auto b = dynamic_cast<const BinaryExpr*>(e)) {
-            gen(b->lhs.get());
-            gen(b->rhs.get());
-            switch (b->op) {
-                case '+': out.emplace_back(OpCode::ADD); break;
-                case '-': out.emplace_back(OpCode::SUB); break;
-                case '*': out.emplace_back(OpCode::MUL); break;
-                case '/': out.emplace_back(OpCode::DIV); break;
+        if (stack.empty()) return {};
+        return stack.back();
+    }
+
+    // Runs register code (see RegCode), with the same results, output and
+    // errors as the stack code for the statement. Variables are checked
+    // for assignment before the code runs, not per load; only when one is
+    // not does it run the checks in load order, to fail where the stack
+    // code would.
+    Value execSingle(const RegCode &rc) {
+        if (frame.size() < symbols().size()) {
+            frame.resize(symbols().size());
+            defined.resize(symbols().size());
+        }
+        if (regs.size() < rc.temps) regs.resize(rc.temps);
+        for (const RegCode::Read &r : rc.reads) {
+            if (!defined[r.sym]) return runRegs<true>(rc);
+        }
+        return runRegs<false>(rc);
+    }
+
+    optional<Value> getVar(Symbol slot) const {
+        return slot < frame.size() && defined[slot] ? optional<Value>(frame[slot]) : nullopt;
+    }
+
+    // Type of the value slot holds, none while unassigned.
+    optional<Type> getType(Symbol slot) const {
+        return slot < frame.size() && defined[slot] ? optional<Type>(Type(defined[slot] - 1)) : nullopt;
+    }
+
+    void setVar(Symbol slot, Value v, Type t) {
+        if (slot >= frame.size()) {
+            frame.resize(symbols().size());
+            defined.resize(symbols().size());
+        }
+        frame[slot] = v;
+        defined[slot] = 1 + uint8_t(t);
+    }
+
+private:
+    template <bool Checked>
+    Value runRegs(const RegCode &rc) {
+        const Value *in[3] = {frame.data(), regs.data(), pool.data()};  // by operand kind
+        Value *out[2] = {frame.data(), regs.data()};
+        auto get = [&](uint32_t x) { return in[x >> 30][x & RegCode::kIndex]; };
+        auto set = [&](uint32_t x, Value v) { out[x >> 30][x & RegCode::kIndex] = v; };
+        size_t read = 0;
+        auto checkReads = [&](size_t ip) {
+            for (; read < rc.reads.size() && rc.reads[read].at <= ip; ++read) {
+                Symbol sym = rc.reads[read].sym;
+                if (!defined[sym]) throw SourceError(rc.reads[read].pos, "VM: undefined variable '" + string(symbols().name(sym)) + "'");
             }
+        };
+        for (size_t ip = 0; ip < rc.code.size(); ++ip) {
+            const RegInstr &ins = rc.code[ip];
+            if constexpr (Checked) checkReads(ip);
+            switch (ins.op) {
+                case RegOp::MOVE: set(ins.dst, get(ins.a)); break;
+                case RegOp::IADD: set(ins.dst, Value::ofInt(intArith<'+'>(get(ins.a).i(), get(ins.b).i(), ins.pos))); break;
+                case RegOp::ISUB: set(ins.dst, Value::ofInt(intArith<'-'>(get(ins.a).i(), get(ins.b).i(), ins.pos))); break;
+                case RegOp::IMUL: set(ins.dst, Value::ofInt(intArith<'*'>(get(ins.a).i(), get(ins.b).i(), ins.pos))); break;
+                case RegOp::FADD: set(ins.dst, Value::ofFloat(floatArith<'+'>(get(ins.a).f(), get(ins.b).f(), ins.pos))); break;
+                case RegOp::FSUB: set(ins.dst, Value::ofFloat(floatArith<'-'>(get(ins.a).f(), get(ins.b).f(), ins.pos))); break;
+                case RegOp::FMUL: set(ins.dst, Value::ofFloat(floatArith<'*'>(get(ins.a).f(), get(ins.b).f(), ins.pos))); break;
+                case RegOp::FDIV: set(ins.dst, Value::ofFloat(floatArith<'/'>(get(ins.a).f(), get(ins.b).f(), ins.pos))); break;
+                case RegOp::I2F: set(ins.dst, Value::ofFloat(double(get(ins.a).i()))); break;
+                case RegOp::IPRINT: printValue(get(ins.a), Type::Int); break;
+                case RegOp::FPRINT: printValue(get(ins.a), Type::Float); break;
+                default: throw runtime_error("VM: unknown opcode");
+            }
+        }
+        if constexpr (Checked) checkReads(rc.code.size());
+        for (const RegCode::Store &st : rc.stores) defined[st.sym] = 1 + uint8_t(st.type);
+        return rc.result ? get(*rc.result) : Value{};
+    }
+
+    // Replaces the top two cells, l under r, with l op r.
+    template <char op>
+    void intOp(uint32_t pos) {
+        if (stack.size() < 2) throw runtime_error("VM: stack underflow");
+        int64_t r = stack.back().i(); stack.pop_back();
+        stack.back() = Value::ofInt(intArith<op>(stack.back().i(), r, pos));
+    }
+    template <char op>
+    void floatOp(uint32_t pos) {
+        if (stack.size() < 2) throw runtime_error("VM: stack underflow");
+        double r = stack.back().f(); stack.pop_back();
+        stack.back() = Value::ofFloat(floatArith<op>(stack.back().f(), r, pos));
+    }
+};
+
+void SemanticAnalyzer::settle(const VM &vm) {
+    for (Symbol sym : unsettled) {
+        optional<Type> t = vm.getType(sym);
+        vars[sym] = t ? 1 + uint8_t(*t) : 0;
+    }
+    unsettled.clear();
+}
+
+/* Runs FlatAst statements without generating code. Children precede their
+ *   parent, so one forward pass over a statement's nodes computes each
+ *   value from ones already computed; values are kept per node, so there is
+ *   no operand stack either. Node types come from the analyzed tree.
+ *   Results, output and errors match CodeGen + VM. */
+class FlatEvaluator {
+    vector<Value> vals;  // per node of the running statement
+    vector<Value> vars;  // by Symbol
+    vector<char> defined;
+public:
+    Value run(const FlatAst &ast, size_t stmt) {
+        uint32_t base = ast.stmtBegin(stmt), end = ast.stmtEnd[stmt];
+        vals.resize(end - base);
+        vars.resize(symbols().size());
+        defined.resize(symbols().size());
+        auto asFloat = [&](uint32_t i) { return this->asFloat(ast, base, i); };
+        for (uint32_t i = base; i < end; ++i) {
+            const FlatNode &n = ast.nodes[i];
+            Value &v = vals[i - base];
+            switch (n.kind) {
+                case FlatKind::Number: v = ast.numbers[n.a]; break;
+                case FlatKind::Variable:
+                    if (!defined[n.a]) throw SourceError(n.pos, "VM: undefined variable '" + string(symbols().name(n.a)) + "'");
+                    v = vars[n.a];
+                    break;
+                case FlatKind::Binary:
+                    switch (n.op) {
+                        case '+': v = binary<'+'>(ast, base, n); break;
+                        case '-': v = binary<'-'>(ast, base, n); break;
+                        case '*': v = binary<'*'>(ast, base, n); break;
+                        case '/': v = binary<'/'>(ast, base, n); break;
+                    }
+                    break;
+                case FlatKind::Assign:
+                    v = n.type == Type::Float ? Value::ofFloat(asFloat(n.a)) : vals[n.a - base];
+                    vars[n.b] = v;
+                    defined[n.b] = 1;
+                    break;
+                case FlatKind::Print:
+                    printValue(vals[n.a - base], ast.nodes[n.a].type);
+                    v = {};  // the VM's PRINT leaves an empty stack
+                    break;
+            }
+        }
+        return vals[end - 1 - base];
+    }
+
+private:
+    // Value of node i as a double, converting an int64.
+    double asFloat(const FlatAst &ast, uint32_t base, uint32_t i) const {
+        Value v = vals[i - base];
+        return ast.nodes[i].type == Type::Int ? double(v.i()) : v.f();
+    }
+    template <char op>
+    Value binary(const FlatAst &ast, uint32_t base, const FlatNode &n) const {
+        if constexpr (op != '/') {
+            if (n.type == Type::Int) return Value::ofInt(intArith<op>(vals[n.a - base].i(), vals[n.b - base].i(), n.pos));
+        }
+        return Value::ofFloat(floatArith<op>(asFloat(ast, base, n.a), asFloat(ast, base, n.b), n.pos));
+    }
+};
+
+/* ------------------- IR: static single assignment form ------------------- */
+/* A place between the trees and the code for passes that rewrite programs.
+ *   Every instruction defines at most one value, named by its index (%n),
+ *   and operands name values defined before their user, so a pass follows
+ *   an operand straight to its definition and never tracks variables:
+ *   the builder resolves them, giving a read after an assignment the value
+ *   assigned and loading a variable from its slot only when the function
+ *   has not assigned it yet (once). Stores stay, in order, for the code
+ *   that runs later. Instructions are in basic blocks, each ended by its
+ *   one terminator; straight-line code is a single block ending in ret,
+ *   which returns the last statement's value. Types are the analyzed
+ *   tree's, with the int64 operands of double operators and assignments
+ *   converted by explicit i2f instructions. */
+namespace ir {
+
+using ValueId = uint32_t;
+constexpr ValueId kNone = UINT32_MAX;
+
+enum class Op : uint8_t {
+    Const, Load, Add, Sub, Mul, Div, IntToFloat,  // define a value
+    Store, Print,                                  // effects only
+    Ret,                                           // terminator
+};
+
+struct Inst {
+    Op op;
+    Type type = Type::Int;         // of the value defined, stored, printed or returned
+    ValueId a = kNone, b = kNone;  // operands
+    Symbol sym = 0;                // Load, Store: the variable
+    Value imm = {};                // Const
+    uint32_t pos = 0;              // source offset, for runtime errors
+};
+
+static bool definesValue(Op op) { return op <= Op::IntToFloat; }
+static bool isArith(Op op) { return op >= Op::Add && op <= Op::Div; }
+
+struct Block {
+    vector<ValueId> insts;  // in order; the last is the terminator
+};
+
+struct Function {
+    vector<Inst> values;  // by ValueId, with those passes dropped from every block
+    vector<Block> blocks;
+
+    ValueId append(Block &b, const Inst &i) {
+        values.push_back(i);
+        b.insts.push_back(ValueId(values.size() - 1));
+        return b.insts.back();
+    }
+};
+
+/* Builds a Function from analyzed statements, in order; finish() adds the
+ *   terminator. A shared node (see HashCons) is built once per statement, as
+ *   CodeGen computes it once, and not across statements, where variables it
+ *   reads may be assigned in between. */
+class Builder {
+    Function &f;
+    unordered_map<Symbol, ValueId> vars;  // the variables' current values
+    unordered_map<const Expr*, ValueId> built;  // shared nodes of the statement
+    vector<ValueId> vals;  // values of the nodes visited, as the stack code's stack
+    ValueId last = kNone;  // value of the last statement; none after print
+public:
+    explicit Builder(Function &fn): f(fn) { if (f.blocks.empty()) f.blocks.emplace_back(); }
+
+    void statement(const Expr *stmt) {
+        built.clear();
+        vals.clear();
+        auto enter = [&](const Expr *e) {
+            if (!e->shared) return true;
+            auto it = built.find(e);
+            if (it == built.end()) return true;
+            vals.push_back(it->second);
+            return false;
+        };
+        walkPostorder(stmt, [&](const Expr *e) {
+            visitExpr(*e, ast::Overloaded{
+                [&](const NumberExpr &n) { vals.push_back(emit({.op = Op::Const, .type = n.type, .imm = n.value, .pos = n.pos})); },
+                [&](const VariableExpr &v) {
+                    auto [it, inserted] = vars.try_emplace(v.sym);
+                    if (inserted) it->second = emit({.op = Op::Load, .type = v.type, .sym = v.sym, .pos = v.pos});
+                    vals.push_back(it->second);
+                },
+                [&](const BinaryExpr &b) {
+                    ValueId r = pop(), l = pop();
+                    if (b.type == Type::Float) {
+                        l = asFloat(l);
+                        r = asFloat(r);
+                    }
+                    Op op;
+                    switch (b.op) {
+                        case '+': op = Op::Add; break;
+                        case '-': op = Op::Sub; break;
+                        case '*': op = Op::Mul; break;
+                        case '/': op = Op::Div; break;
+                        default: throw runtime_error("IR: unknown op");
+                    }
+                    ValueId v = emit({.op = op, .type = b.type, .a = l, .b = r, .pos = b.pos});
+                    if (b.shared) built.emplace(&b, v);
+                    vals.push_back(v);
+                },
+                [&](const AssignExpr &a) {
+                    ValueId v = pop();
+                    if (a.type == Type::Float) v = asFloat(v);
+                    emit({.op = Op::Store, .type = a.type, .a = v, .sym = a.sym, .pos = a.pos});
+                    vars[a.sym] = v;
+                    vals.push_back(v);
+                },
+                [&](const PrintExpr &p) { emit({.op = Op::Print, .type = p.value->type, .a = pop(), .pos = p.pos}); },
+            });
+        }, enter);
+        last = vals.empty() ? kNone : vals.back();
+    }
+
+    void finish() {
+        Type t = last == kNone ? Type::Int : f.values[last].type;
+        emit({.op = Op::Ret, .type = t, .a = last});
+    }
+
+private:
+    ValueId emit(const Inst &i) { return f.append(f.blocks.back(), i); }
+    ValueId pop() {
+        ValueId v = vals.back();
+        vals.pop_back();
+        return v;
+    }
+    ValueId asFloat(ValueId v) {
+        if (f.values[v].type == Type::Float) return v;
+        return emit({.op = Op::IntToFloat, .type = Type::Float, .a = v, .pos = f.values[v].pos});
+    }
+};
+
+inline Function build(const vector<Expr*> &prog) {
+    Function f;
+    Builder b(f);
+    for (const Expr *s : prog) b.statement(s);
+    b.finish();
+    return f;
+}
+
+static Function build(const Expr *stmt) {
+    Function f;
+    f.values.reserve(32);  // one allocation for a typical statement
+    Builder b(f);
+    f.blocks[0].insts.reserve(32);
+    b.statement(stmt);
+    b.finish();
+    return f;
+}
+
+/* Throws at the first thing passes and lowering rely on that f breaks:
+ *   every operand is a value defined earlier in block order, operand types
+ *   are what the instruction takes, and every block ends with its only
+ *   terminator. A variable's loads and stores need not agree on its type:
+ *   the analyzer types an unassigned variable's load int64 whatever is
+ *   stored to it later, as the load stops the program. */
+static void verify(const Function &f) {
+    auto fail = [](ValueId id, const string &what) {
+        throw runtime_error("IR verifier: %" + to_string(id) + " " + what);
+    };
+    if (f.blocks.empty()) throw runtime_error("IR verifier: function has no blocks");
+    vector<char> defined(f.values.size());
+    for (const Block &b : f.blocks) {
+        if (b.insts.empty()) throw runtime_error("IR verifier: empty block");
+        for (size_t k = 0; k < b.insts.size(); ++k) {
+            ValueId id = b.insts[k];
+            if (id >= f.values.size()) fail(id, "is not in the function");
+            if (defined[id]) fail(id, "appears twice");
+            const Inst &i = f.values[id];
+            auto operand = [&](ValueId x, Type t) {
+                if (x >= f.values.size() || !defined[x]) fail(id, "uses a value not defined before it");
+                if (!definesValue(f.values[x].op)) fail(id, "uses %" + to_string(x) + ", which defines no value");
+                if (f.values[x].type != t) fail(id, "uses %" + to_string(x) + " of the wrong type");
+            };
+            switch (i.op) {
+                case Op::Const: case Op::Load: break;
+                case Op::Div:
+                    if (i.type != Type::Float) fail(id, "divides int64");
+                    [[fallthrough]];
+                case Op::Add: case Op::Sub: case Op::Mul:
+                    operand(i.a, i.type);
+                    operand(i.b, i.type);
+                    break;
+                case Op::IntToFloat:
+                    if (i.type != Type::Float) fail(id, "converts to int64");
+                    operand(i.a, Type::Int);
+                    break;
+                case Op::Store: operand(i.a, i.type); break;
+                case Op::Print: operand(i.a, i.type); break;
+                case Op::Ret:
+                    if (k + 1 != b.insts.size()) fail(id, "ends its block early");
+                    if (i.a != kNone) operand(i.a, i.type);
+                    break;
+                default: fail(id, "has an unknown op");
+            }
+            if (i.op != Op::Ret && k + 1 == b.insts.size()) fail(id, "ends a block without a terminator");
+            defined[id] = 1;
+        }
+    }
+}
+
+static const char *typeName(Type t) { return t == Type::Int ? "i64" : "f64"; }
+
+// Writes f as text, one instruction a line, e.g. "  %2 = add i64 %0, %1".
+inline void dump(const Function &f, ostream &out) {
+    static const char *const kArith[] = {"add", "sub", "mul", "div"};
+    auto ref = [](ValueId x) { return "%" + to_string(x); };
+    for (size_t bi = 0; bi < f.blocks.size(); ++bi) {
+        out << "block" << bi << ":\n";
+        for (ValueId id : f.blocks[bi].insts) {
+            const Inst &i = f.values[id];
+            out << "  ";
+            if (definesValue(i.op)) out << ref(id) << " = ";
+            switch (i.op) {
+                case Op::Const: {
+                    char buf[32];  // shortest text that reads back as the value
+                    auto r = i.type == Type::Int ? to_chars(buf, end(buf), i.imm.i()) : to_chars(buf, end(buf), i.imm.f());
+                    out << "const " << typeName(i.type) << " " << string_view(buf, r.ptr - buf);
+                } break;
+                case Op::Load: out << "load " << typeName(i.type) << " " << symbols().name(i.sym); break;
+                case Op::Add: case Op::Sub: case Op::Mul: case Op::Div:
+                    out << kArith[int(i.op) - int(Op::Add)] << " " << typeName(i.type) << " " << ref(i.a) << ", " << ref(i.b);
+                    break;
+                case Op::IntToFloat: out << "i2f f64 " << ref(i.a); break;
+                case Op::Store: out << "store " << typeName(i.type) << " " << symbols().name(i.sym) << ", " << ref(i.a); break;
+                case Op::Print: out << "print " << typeName(i.type) << " " << ref(i.a); break;
+                case Op::Ret:
+                    out << "ret";
+                    if (i.a != kNone) out << " " << typeName(i.type) << " " << ref(i.a);
+                    break;
+            }
+            out << "\n";
+        }
+    }
+}
+
+/* ------------------- IR passes ------------------- */
+// l op r for an arithmetic instruction, with the VM's errors.
+static Value evalArith(Op op, Type t, Value l, Value r, uint32_t pos) {
+    if (t == Type::Int) {
+        switch (op) {
+            case Op::Add: return Value::ofInt(intArith<'+'>(l.i(), r.i(), pos));
+            case Op::Sub: return Value::ofInt(intArith<'-'>(l.i(), r.i(), pos));
+            default: return Value::ofInt(intArith<'*'>(l.i(), r.i(), pos));
+        }
+    }
+    switch (op) {
+        case Op::Add: return Value::ofFloat(floatArith<'+'>(l.f(), r.f(), pos));
+        case Op::Sub: return Value::ofFloat(floatArith<'-'>(l.f(), r.f(), pos));
+        case Op::Mul: return Value::ofFloat(floatArith<'*'>(l.f(), r.f(), pos));
+        default: return Value::ofFloat(floatArith<'/'>(l.f(), r.f(), pos));
+    }
+}
+
+/* Constant folding: an operator on constants becomes a constant, as does
+ *   i2f of one, and x + 0, x - 0, x * 1 and x / 1 become x (for doubles
+ *   only x - 0.0, x * 1.0 and x / 1.0: -0.0 + 0.0 is 0.0). An operator
+ *   that stops the program (overflow, division by zero) is left for the
+ *   code to report where it runs. What folding orphans is left for dce. */
+static void fold(Function &f) {
+    vector<ValueId> repl(f.values.size(), kNone);
+    auto isConst = [&](ValueId x) { return x != kNone && f.values[x].op == Op::Const; };
+    for (Block &b : f.blocks) {
+        for (ValueId id : b.insts) {
+            Inst &i = f.values[id];
+            if (i.a != kNone && repl[i.a] != kNone) i.a = repl[i.a];
+            if (i.b != kNone && repl[i.b] != kNone) i.b = repl[i.b];
+            if (i.op == Op::IntToFloat && isConst(i.a)) {
+                i = {.op = Op::Const, .type = Type::Float, .imm = Value::ofFloat(double(f.values[i.a].imm.i())), .pos = i.pos};
+                continue;
+            }
+            if (!isArith(i.op)) continue;
+            if (isConst(i.a) && isConst(i.b)) {
+                try {
+                    i.imm = evalArith(i.op, i.type, f.values[i.a].imm, f.values[i.b].imm, i.pos);
+                    i.op = Op::Const;
+                    i.a = i.b = kNone;
+                } catch (const SourceError&) {
+                }
+                continue;
+            }
+            if (!isConst(i.b)) continue;
+            Value r = f.values[i.b].imm;
+            bool identity = i.type == Type::Int
+                ? (i.op == Op::Add || i.op == Op::Sub ? r.i() == 0 : r.i() == 1)
+                : (i.op == Op::Sub ? r == Value::ofFloat(0.0) : i.op != Op::Add && r.f() == 1.0);
+            if (identity) repl[id] = i.a;
+        }
+    }
+}
+
+/* Common subexpressions: an operator equal to an earlier one (same op and
+ *   type, same operands in either order for + and *) is dropped and its
+ *   uses take the earlier value; had it stopped the program, the earlier
+ *   one would have first. Equal constants count as the same operand but
+ *   stay apart, as the stack code pushes each where it is used. Loads are
+ *   left alone: the builder loads a variable once already, and a load
+ *   after a store must not become one before it. */
+static void cse(Function &f) {
+    struct Key {
+        Op op;
+        Type type;
+        ValueId a, b;
+        uint64_t imm;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &k) const {
+            uint64_t h = (uint64_t(k.op) << 8 | uint64_t(k.type)) ^ (uint64_t(k.a) << 32 | k.b) * 0x9e3779b97f4a7c15ull;
+            return size_t(h ^ k.imm * 0xff51afd7ed558ccdull);
+        }
+    };
+    unordered_map<Key, ValueId, KeyHash> seen;
+    vector<ValueId> repl(f.values.size(), kNone);  // dropped -> earlier value
+    vector<ValueId> same(f.values.size(), kNone);  // constant -> first equal one
+    auto canon = [&](ValueId x) { return x != kNone && same[x] != kNone ? same[x] : x; };
+    for (Block &b : f.blocks) {
+        for (ValueId id : b.insts) {
+            Inst &i = f.values[id];
+            if (i.a != kNone && repl[i.a] != kNone) i.a = repl[i.a];
+            if (i.b != kNone && repl[i.b] != kNone) i.b = repl[i.b];
+            if (i.op != Op::Const && i.op != Op::IntToFloat && !isArith(i.op)) continue;
+            Key k{i.op, i.type, canon(i.a), canon(i.b), i.op == Op::Const ? i.imm.bits : 0};
+            if ((i.op == Op::Add || i.op == Op::Mul) && k.a > k.b) swap(k.a, k.b);
+            auto [it, inserted] = seen.try_emplace(k, id);
+            if (inserted) continue;
+            if (i.op == Op::Const) same[id] = it->second;
+            else repl[id] = it->second;
+        }
+        erase_if(b.insts, [&](ValueId id) { return repl[id] != kNone; });
+    }
+}
+
+// Whether i may stop the program: int64 overflow, division by zero or an
+// unassigned variable. Only operands that are constants are considered.
+static bool mayTrap(const Function &f, const Inst &i) {
+    if (i.op == Op::Load) return true;
+    if (!isArith(i.op)) return false;
+    auto constant = [&](ValueId x, int64_t v) {
+        const Inst &d = f.values[x];
+        return d.op == Op::Const && (i.type == Type::Int ? d.imm.i() == v : d.imm.f() == double(v));
+    };
+    const Inst &r = f.values[i.b];
+    if (i.op == Op::Div) return r.op != Op::Const || constant(i.b, 0);
+    if (i.type == Type::Float) return false;
+    switch (i.op) {
+        case Op::Add: return !constant(i.a, 0) && !constant(i.b, 0);
+        case Op::Sub: return !constant(i.b, 0);
+        default: return !constant(i.a, 0) && !constant(i.a, 1) && !constant(i.b, 0) && !constant(i.b, 1);
+    }
+}
+
+/* Dead code: removes values nothing uses, last first so whole chains go
+ *   in one pass, unless computing them may stop the program (see mayTrap):
+ *   those stay until an analysis (of ranges, of assignment) shows they
+ *   cannot. */
+static void dce(Function &f) {
+    vector<uint32_t> uses(f.values.size());
+    for (const Block &b : f.blocks) {
+        for (ValueId id : b.insts) {
+            const Inst &i = f.values[id];
+            if (i.a != kNone) ++uses[i.a];
+            if (i.b != kNone) ++uses[i.b];
+        }
+    }
+    for (Block &b : f.blocks) {
+        vector<ValueId> kept;
+        for (auto it = b.insts.rbegin(); it != b.insts.rend(); ++it) {
+            const Inst &i = f.values[*it];
+            if (uses[*it] == 0 && definesValue(i.op) && !mayTrap(f, i)) {
+                if (i.a != kNone) --uses[i.a];
+                if (i.b != kNone) --uses[i.b];
+                continue;
+            }
+            kept.push_back(*it);
+        }
+        b.insts.assign(kept.rbegin(), kept.rend());
+    }
+}
+
+/* Runs passes in order and verifies the result. With verifyEach it also
+ *   verifies the function before the first pass and after each, so a pass
+ *   that breaks it is named rather than its victims; that costs more than
+ *   the passes, so the drivers ask for it only when not about to run the
+ *   code (--dump-ir, --asm). */
+class PassManager {
+    vector<pair<const char*, void (*)(Function&)>> passes;
+public:
+    bool verifyEach = false;
+
+    PassManager &add(const char *name, void (*pass)(Function&)) {
+        passes.emplace_back(name, pass);
+        return *this;
+    }
+
+    void run(Function &f) const {
+        if (verifyEach) check(f, "building");
+        for (auto &[name, pass] : passes) {
+            pass(f);
+            if (verifyEach) check(f, name);
+        }
+        if (!verifyEach) check(f, passes.empty() ? "building" : passes.back().first);
+    }
+
+    // The passes the drivers run.
+    static const PassManager &standard() {
+        static const PassManager pm = PassManager().add("fold", fold).add("cse", cse).add("dce", dce);
+        return pm;
+    }
+
+private:
+    static void check(const Function &f, const char *after) {
+        try {
+            verify(f);
+        } catch (const runtime_error &e) {
+            throw runtime_error(string(e.what()) + " (after " + after + ")");
+        }
+    }
+};
+
+/* ------------------- IR lowering ------------------- */
+/* Appends stack code for f, leaving the value it returns on top of the
+ *   stack. The code is the trees the values form, one per root in order:
+ *   the instructions with effects, and values nothing uses that may stop
+ *   the program. An operand is computed where its user needs it, which
+ *   for a function built from trees is where the trees' code computes it,
+ *   so output and errors come in the same order. Constants are pushed and
+ *   variables loaded at each use. Anything else used twice is computed
+ *   once, at its first use, and copied to a temporary there (SAVE_TMP) for
+ *   the others (LOAD_TMP), as a shared node is; so is a variable's value
+ *   used after a store to it. */
+static void lowerToStack(const Function &f, ConstPool &pool, vector<Instr> &out) {
+    vector<uint32_t> uses(f.values.size());
+    for (const Block &b : f.blocks) {
+        for (ValueId id : b.insts) {
+            const Inst &i = f.values[id];
+            if (i.a != kNone) ++uses[i.a];
+            if (i.b != kNone) ++uses[i.b];
+        }
+    }
+    // Run twice: first without code, to find the values the second saves.
+    vector<char> saved(f.values.size()), computed(f.values.size());
+    unordered_set<Symbol> stored;
+    vector<uint32_t> temps(f.values.size());
+    struct Frame { ValueId id; bool expanded; };
+    vector<Frame> stack;
+    auto emit = [&](bool dry) {
+        fill(computed.begin(), computed.end(), 0);
+        stored.clear();
+        uint32_t nextTemp = 0;
+        ValueId top = kNone;  // left on top of the stack by the last root
+        // Pushes value id for a user, computing it the first time.
+        auto reuse = [&](ValueId id) {
+            const Inst &i = f.values[id];
+            bool load = i.op == Op::Load && !stored.count(i.sym) && (computed[id] || !saved[id]);
+            if (i.op == Op::Const) {
+                if (!dry) out.emplace_back(OpCode::PUSH_CONST, pool.intern(i.imm));
+            } else if (load) {
+                computed[id] = 1;
+                if (!dry) out.emplace_back(OpCode::LOAD_SLOT, i.sym, i.pos);
+            } else if (computed[id]) {
+                saved[id] |= dry;
+                if (!dry) out.emplace_back(OpCode::LOAD_TMP, temps[id]);
+            } else {
+                return false;  // computed here, and saved if marked
+            }
+            return true;
+        };
+        for (const Block &b : f.blocks) {
+            for (ValueId root : b.insts) {
+                const Inst &r = f.values[root];
+                if (definesValue(r.op) && (uses[root] || r.op == Op::Const || !mayTrap(f, r))) continue;
+                if (r.op == Op::Ret && r.a == top) break;
+                stack.push_back({root, false});
+                while (!stack.empty()) {
+                    auto [id, expanded] = stack.back();
+                    const Inst &i = f.values[id];
+                    if (!expanded) {
+                        if (id != root && reuse(id)) {
+                            stack.pop_back();
+                            continue;
+                        }
+                        stack.back().expanded = true;
+                        if (i.b != kNone) stack.push_back({i.b, false});
+                        if (i.a != kNone) stack.push_back({i.a, false});
+                        continue;
+                    }
+                    stack.pop_back();
+                    computed[id] = 1;
+                    if (i.op == Op::Store) stored.insert(i.sym);
+                    if (dry) continue;
+                    bool isInt = i.type == Type::Int;
+                    switch (i.op) {
+                        case Op::Const: out.emplace_back(OpCode::PUSH_CONST, pool.intern(i.imm)); break;
+                        case Op::Load: out.emplace_back(OpCode::LOAD_SLOT, i.sym, i.pos); break;
+                        case Op::Add: out.emplace_back(isInt ? OpCode::IADD : OpCode::FADD, 0, i.pos); break;
+                        case Op::Sub: out.emplace_back(isInt ? OpCode::ISUB : OpCode::FSUB, 0, i.pos); break;
+                        case Op::Mul: out.emplace_back(isInt ? OpCode::IMUL : OpCode::FMUL, 0, i.pos); break;
+                        case Op::Div: out.emplace_back(OpCode::FDIV, 0, i.pos); break;
+                        case Op::IntToFloat: out.emplace_back(OpCode::I2F); break;
+                        case Op::Store: out.emplace_back(isInt ? OpCode::ISTORE_SLOT : OpCode::FSTORE_SLOT, i.sym); break;
+                        case Op::Print: emitPrint(i.type, out); break;
+                        case Op::Ret: break;
+                    }
+                    if (saved[id]) {
+                        temps[id] = nextTemp++;
+                        out.emplace_back(OpCode::SAVE_TMP, temps[id]);
+                    }
+                }
+                top = r.op == Op::Store ? r.a : r.op == Op::Print ? kNone : root;
+            }
+        }
+    };
+    emit(true);
+    emit(false);
+}
+
+/* Writes f as a NASM program for x86-64 Linux, with the entry and exit
+ *   sequences of the dead compiler (common/nasm.hpp): it runs from _start
+ *   and exits with the value f returns as its status, as dead's return
+ *   does. Each value has an 8-byte slot in the frame. Print writes the
+ *   value in decimal and a newline to stdout; overflow and a load write
+ *   the VM's message to stderr and exit with status 1.
+ *   No variable is assigned before the program starts, so the first load
+ *   always stops it and nothing after it gets code. Stores need none
+ *   either: nothing runs after the program to read them. int64 only for
+ *   now; doubles need SSE code and a formatter. */
+inline void lowerToNasm(const Function &f, ostream &out) {
+    // The instructions that run, in order: through the first load.
+    vector<ValueId> code;
+    for (const Block &b : f.blocks) code.insert(code.end(), b.insts.begin(), b.insts.end());
+    auto load = find_if(code.begin(), code.end(), [&](ValueId id) { return f.values[id].op == Op::Load; });
+    if (load != code.end()) code.erase(load + 1, code.end());
+
+    vector<uint32_t> slots(f.values.size());
+    uint32_t frame = 0;
+    bool prints = false;
+    for (ValueId id : code) {
+        const Inst &i = f.values[id];
+        if (i.op == Op::Load) break;
+        if (i.type == Type::Float) throw SourceError(i.pos, "asm: double values are not supported");
+        if (definesValue(i.op) && i.op != Op::Const) slots[id] = frame++;
+        prints |= i.op == Op::Print;
+    }
+    auto operand = [&](ValueId x) {
+        const Inst &d = f.values[x];
+        if (d.op == Op::Const) return to_string(d.imm.i());
+        return "qword [rbp - " + to_string(8 * (slots[x] + 1)) + "]";
+    };
+    vector<pair<string, string>> messages;  // label, text
+    auto fail = [&](const string &label, const string &text) {
+        if (none_of(messages.begin(), messages.end(), [&](auto &m) { return m.first == label; }))
+            messages.emplace_back(label, text);
+        out << "    lea rsi, [rel " << label << "]\n    mov rdx, " << label << "_len\n    jmp toy_fail\n";
+    };
+    static const char *const kArith[] = {"add", "sub", "imul"};
+
+    nasm::emit_start(out);
+    out << "    mov rbp, rsp\n";
+    if (frame) out << "    sub rsp, " << 8 * frame << "\n";
+    for (ValueId id : code) {
+        const Inst &i = f.values[id];
+        switch (i.op) {
+            case Op::Const: case Op::Store: continue;
+            case Op::Load:
+                fail("undefined_" + to_string(i.sym), "VM: undefined variable '" + string(symbols().name(i.sym)) + "'");
+                continue;
+            case Op::Add: case Op::Sub: case Op::Mul:
+                out << "    mov rax, " << operand(i.a) << "\n    mov rcx, " << operand(i.b) << "\n";
+                out << "    " << kArith[int(i.op) - int(Op::Add)] << " rax, rcx\n    jo toy_overflow\n";
+                break;
+            case Op::Div: case Op::IntToFloat: break;  // doubles, rejected above
+            case Op::Print:
+                out << "    mov rax, " << operand(i.a) << "\n    call toy_print\n";
+                continue;
+            case Op::Ret:
+                nasm::emit_exit(out, i.a == kNone ? "0" : operand(i.a));
+                continue;
+        }
+        out << "    mov " << operand(id) << ", rax\n";
+    }
+
+    if (prints) {
+        // rax in decimal and a newline, built backwards in a stack buffer.
+        out << "toy_print:\n"
+               "    sub rsp, 32\n"
+               "    lea rsi, [rsp + 31]\n"
+               "    mov byte [rsi], 10\n"
+               "    mov r8, rax\n"
+               "    test rax, rax\n"
+               "    jns .digits\n"
+               "    neg rax\n"
+               ".digits:\n"
+               "    mov rcx, 10\n"
+               ".next:\n"
+               "    xor edx, edx\n"
+               "    div rcx\n"
+               "    add dl, '0'\n"
+               "    dec rsi\n"
+               "    mov [rsi], dl\n"
+               "    test rax, rax\n"
+               "    jnz .next\n"
+               "    test r8, r8\n"
+               "    jns .write\n"
+               "    dec rsi\n"
+               "    mov byte [rsi], '-'\n"
+               ".write:\n"
+               "    lea rdx, [rsp + 32]\n"
+               "    sub rdx, rsi\n"
+               "    mov rax, 1\n"
+               "    mov rdi, 1\n"
+               "    syscall\n"
+               "    add rsp, 32\n"
+               "    ret\n";
+    }
+    out << "toy_overflow:\n";
+    fail("overflow_msg", "VM: int64 overflow");
+    // Writes rdx bytes at rsi to stderr and exits with status 1.
+    out << "toy_fail:\n    mov rax, 1\n    mov rdi, 2\n    syscall\n";
+    nasm::emit_exit(out, "1");
+    out << "section .rodata\n";
+    for (auto &[label, text] : messages) {
+        out << label << ": db \"" << text << "\", 10\n" << label << "_len equ $ - " << label << "\n";
+    }
+}
+
+} // namespace ir
+
+/* ------------------- Small helper to generate per-statement code ------------------- */
+// Replaces the contents of `out`, so callers can reuse one buffer.
+void genForStmt(const Expr *stmt, ConstPool &pool, vector<Instr> &out) {
+    out.clear();
+    emitExpr(stmt, pool, out);
+}
+
+void genForStmt(const FlatAst &ast, size_t stmt, ConstPool &pool, vector<Instr> &out) {
+    out.clear();
+    emitFlat(ast, ast.stmtBegin(stmt), ast.stmtEnd[stmt], pool, out);
+}
+
+void genForStmt(const Expr *stmt, ConstPool &pool, RegCode &out) {
+    out.clear();
+    emitRegs(stmt, pool, out);
+}
+
+// Through the IR (--ir): build, the passes, stack code.
+void genForStmt(const Expr *stmt, ConstPool &pool, vector<Instr> &out, const ir::PassManager &passes) {
+    ir::Function f = ir::build(stmt);
+    passes.run(f);
+    out.clear();
+    ir::lowerToStack(f, pool, out);
+}
+
+vector<Instr> genForStmt(const Expr *stmt, ConstPool &pool) {
+    vector<Instr> out;
+    genForStmt(stmt, pool, out);
+    return out;
+}
+
+/* ------------------- DirectCompiler: tokens straight to code ------------------- */
+/* The -O0 path: compiles statements from their tokens to the same stack
+ *   code CodeGen emits for their trees, without building a tree. Short
+ *   statements spend most of their compile time allocating nodes and
+ *   walking them; here each operand is emitted as it is read and each
+ *   operator as Parser::parseExpression would reduce it into a node, which
+ *   is the tree's post-order. Prefix minus, the node 0 - x in the tree,
+ *   emits its 0 when it is read. With no tree there is nothing to share
+ *   (--share) or to optimize later.
+ *
+ *   Semantic analysis happens on the way through the same
+ *   SemanticAnalyzer calls the tree pass makes, in the same order, so
+ *   diagnostics and types match too; `types` holds the type of each value
+ *   the code leaves on the stack. */
+class DirectCompiler : public TokenCursor {
+    ConstPool &pool;
+    SemanticAnalyzer &sem;
+    vector<Instr> *out = nullptr;
+    vector<Type> types;
+    optional<Type> result;
+
+    struct PendingOp {
+        enum Kind : uint8_t { Negate, Paren, Binary } kind;
+        parse::Infix infix;  // Binary only
+        uint32_t at;
+    };
+    vector<PendingOp> ops;
+public:
+    DirectCompiler(const TokenStream &t, ConstPool &p, SemanticAnalyzer &s): TokenCursor(t), pool(p), sem(s) {}
+
+    // Appends the next statement's code to code and consumes its ';';
+    // false at the end of the tokens. Diagnostics add to sem's.
+    bool compileNext(vector<Instr> &code) {
+        if (pos >= toks.size() || peek() == TokenKind::End) return false;
+        out = &code;
+        types.clear();
+        compileStatement();
+        if (!accept(TokenKind::Semicolon) && peek() != TokenKind::End) {
+            throw SourceError(here(), "Parser: expected ';' after statement");
+        }
+        return true;
+    }
+
+    // Type of the value the last statement compiled leaves, none for print.
+    optional<Type> resultType() const { return result; }
+
+private:
+    void compileStatement() {
+        if (accept(TokenKind::KeywordPrint)) {
+            // print ( <expr> )  or print <expr>
+            bool paren = accept(TokenKind::LParen);
+            compileExpression();
+            if (paren && !accept(TokenKind::RParen)) throw SourceError(here(), "Parser: expected ')'");
+            emitPrint(types.back(), *out);
+            result = nullopt;
+        } else if (atAssignment()) {
+            TokenRef id{&toks, pos};
+            pos += 2;
+            compileExpression();
+            Type var = sem.assign(id.symbol(), types.back());
+            emitStore(id.symbol(), var, types.back(), *out);
+            result = var;
+        } else {
+            compileExpression();
+            result = types.back();
+        }
+    }
+
+    void reduce() {
+        PendingOp op = ops.back();
+        ops.pop_back();
+        Type rhs = types.back();
+        types.pop_back();
+        char c = op.kind == PendingOp::Negate ? '-' : op.infix.op;
+        emitBinary(c, types.back(), rhs, op.at, *out);
+        types.back() = binaryType(c, types.back(), rhs);
+    }
+
+    void reduceNegations() {
+        while (!ops.empty() && ops.back().kind == PendingOp::Negate) reduce();
+    }
+
+    void reduceBinaries(uint8_t lbp) {
+        while (!ops.empty() && ops.back().kind == PendingOp::Binary && ops.back().infix.rbp >= lbp) reduce();
+    }
+
+    // Parser::parseExpression with instructions in place of nodes.
+    void compileExpression() {
+        ops.clear();
+        size_t open = 0;  // '(' on ops
+        while (true) {
+            for (TokenKind k = peek(); k == TokenKind::Minus || k == TokenKind::LParen; k = peek()) {
+                uint32_t at = get().offset();
+                if (k == TokenKind::Minus) {
+                    out->emplace_back(OpCode::PUSH_CONST, pool.intern(kZero.value));
+                    types.push_back(kZero.type);
+                    ops.push_back({PendingOp::Negate, {}, at});
+                } else {
+                    ops.push_back({PendingOp::Paren, {}, at});
+                    ++open;
+                }
+            }
+            TokenRef t = get();
+            if (t.kind() == TokenKind::Number) {
+                Literal l = t.number();
+                out->emplace_back(OpCode::PUSH_CONST, pool.intern(l.value));
+                types.push_back(l.type);
+            } else if (t.kind() == TokenKind::Identifier) {
+                out->emplace_back(OpCode::LOAD_SLOT, t.symbol(), t.offset());
+                types.push_back(sem.use(t.symbol(), t.offset()));
+            } else {
+                throw SourceError(t.offset(), "Parser: unexpected token '" + string(t.text()) + "'");
+            }
+            reduceNegations();
+
+            while (open > 0 && accept(TokenKind::RParen)) {
+                reduceBinaries(0);
+                ops.pop_back();  // the '('
+                --open;
+                reduceNegations();
+            }
+
+            parse::Infix op = nextOp();
+            if (op.lbp == 0) break;
+            reduceBinaries(op.lbp);
+            ops.push_back({PendingOp::Binary, op, toks.offset(pos++)});
+        }
+        if (open > 0) throw SourceError(here(), "Parser: expected ')'");
+        reduceBinaries(0);
+    }
+};
+
+/* Benchmarks under bench/ include this file with TOY_FINAL_NO_MAIN defined;
+ * they stop here, before the drivers that only main uses. */
+#ifndef TOY_FINAL_NO_MAIN
+
+/* ------------------- Session: state shared by every run ------------------- */
+struct Session {
+    Arena ast;  // nodes of the statement(s) being run
+    HashCons cons;  // cleared with ast
+    bool share = false;  // parse into a DAG (--share)
+    bool direct = false;  // compile without a tree (-O0); see DirectCompiler
+    bool regs = false;  // run register code (--regs); see RegCode
+    bool ir = false;  // compile through the IR (--ir); see ir::Function
+    SemanticAnalyzer sem;
+    ConstPool pool;
+    VM vm{pool};
+};
+
+// Parse, analyze and execute a token stream, echoing results like the REPL.
+// Errors are thrown; warnings are printed at once, placed by `where`.
+static void runTokens(const TokenStream &toks, Session &s, const Locate &where) {
+    if (s.direct) {
+        // Compile every statement before running any, as the tree path does.
+        DirectCompiler compiler(toks, s.pool, s.sem);
+        vector<Instr> code;
+        vector<size_t> ends;
+        vector<optional<Type>> results;
+        s.sem.clearDiagnostics();
+        while (compiler.compileNext(code)) {
+            ends.push_back(code.size());
+            results.push_back(compiler.resultType());
+        }
+
+        for (auto &w : s.sem.getWarnings()) cerr << where(w.offset) << "Warning: " << w.message << "\n";
+        if (!s.sem.getErrors().empty()) {
+            for (auto &e : s.sem.getErrors()) cerr << where(e.offset) << "Error: " << e.message << "\n";
             return;
         }
-        if (auto a = dynamic_cast<const AssignExpr*>(e)) {
-            gen(a->value.get());
-            out.emplace_back(OpCode::STORE_VAR, 0.0, a->name);
+
+        span<const Instr> all(code);
+        size_t begin = 0;
+        for (size_t i = 0; i < ends.size(); ++i) {
+            Value res = s.vm.execSingle(all.subspan(begin, ends[i] - begin));
+            if (results[i]) printValue(res, *results[i]);
+            begin = ends[i];
+        }
+        return;
+    }
+
+    // 2) parse program
+    s.ast.reset();
+    s.cons.clear();
+    Parser parser(toks, s.ast, s.share ? &s.cons : nullptr);
+    auto prog = parser.parseProgram();
+
+    // 3) semantic analyze, on top of what earlier lines defined
+    s.sem.analyzeNext(prog);
+    for (auto &w : s.sem.getWarnings()) cerr << where(w.offset) << "Warning: " << w.message << "\n";
+    if (!s.sem.getErrors().empty()) {
+        for (auto &e : s.sem.getErrors()) cerr << where(e.offset) << "Error: " << e.message << "\n";
+        return;
+    }
+
+    // 4) for each statement: codegen & run
+    RegCode regCode;
+    vector<Instr> code;
+    for (auto &stmt : prog) {
+        Value res;
+        if (s.regs) {
+            genForStmt(stmt, s.pool, regCode);
+            res = s.vm.execSingle(regCode);
+        } else if (s.ir) {
+            genForStmt(stmt, s.pool, code, ir::PassManager::standard());
+            res = s.vm.execSingle(code);
+        } else {
+            res = s.vm.execSingle(genForStmt(stmt, s.pool));
+        }
+        // If statement not a print, print REPL result
+        if (stmt->kind != ExprKind::Print) {
+            // print numeric result for expressions/assignments
+            printValue(res, stmt->type);
+        }
+    }
+}
+
+/* ------------------- Pipeline: one statement at a time ------------------- */
+/* Drives lex -> parse -> analyze -> codegen -> execute per statement: the
+ *   caller pushes a statement's tokens as it lexes them and calls run() at
+ *   its ';'. The statement's output appears before the next one is lexed,
+ *   so the first result of a long script costs one statement, not the whole
+ *   program. Every stage reuses its buffers (token arrays, the AST arena's
+ *   first block, the parser's stacks, the instruction vector, the constant
+ *   pool, the VM stack), so memory does not grow with the length of the
+ *   program; only its variables are kept. The analyzer remembers which
+ *   variables earlier statements assigned. */
+class Pipeline {
+    Session &s;
+    TokenStream stmt;
+    Parser parser{stmt, s.ast, s.share ? &s.cons : nullptr};
+    DirectCompiler compiler{stmt, s.pool, s.sem};
+    vector<Instr> code;
+    RegCode regCode;
+public:
+    explicit Pipeline(Session &session): s(session) {}
+    Pipeline(const Pipeline&) = delete;  // parser refers to stmt
+
+    // Tokens of the current statement; offsets index the `src` given to run().
+    void push(const Token &t) { stmt.push(t); }
+    const TokenStream &tokens() const { return stmt; }
+    bool pending() const { return !stmt.empty(); }
+
+    // Runs the pushed statement, whose offsets are into src. Its tokens stay
+    // until discard(), so errors it throws can still be placed.
+    void run(string_view src, const Locate &where) {
+        stmt.push({TokenKind::End, uint32_t(src.size())});
+        stmt.setSource(src);
+        if (s.direct) {
+            runDirect(where);
             return;
         }
-        if (auto p = dynamic_cast<const PrintExpr*>(e)) {
-            gen(p->value.get());
-            out.emplace_back(OpCode::PRINT);
+
+        s.ast.reset();
+        s.cons.clear();
+        parser.rewind();
+        Expr *e = parser.parseNext();
+        if (!e) return;
+
+        s.sem.analyzeNext(e);
+        for (auto &w : s.sem.getWarnings()) cerr << where(w.offset) << "Warning: " << w.message << "\n";
+        if (!s.sem.getErrors().empty()) {
+            for (auto &err : s.sem.getErrors()) cerr << where(err.offset) << "Error: " << err.message << "\n";
             return;
         }
-    };
-    gen(stmt.get());
-    return out;
+
+        // The code runs at once, so its constants need not outlive it.
+        s.pool.clear();
+        Value res;
+        if (s.regs) {
+            genForStmt(e, s.pool, regCode);
+            res = s.vm.execSingle(regCode);
+        } else {
+            if (s.ir) genForStmt(e, s.pool, code, ir::PassManager::standard());
+            else genForStmt(e, s.pool, code);
+            res = s.vm.execSingle(code);
+        }
+        if (e->kind != ExprKind::Print) printValue(res, e->type);
+    }
+
+    // Ends the statement run last, whether it succeeded or threw.
+    void discard() {
+        stmt.clear();
+        s.sem.settle(s.vm);
+    }
+
+private:
+    void runDirect(const Locate &where) {
+        s.pool.clear();
+        code.clear();
+        compiler.rewind();
+        s.sem.clearDiagnostics();
+        if (!compiler.compileNext(code)) return;
+
+        for (auto &w : s.sem.getWarnings()) cerr << where(w.offset) << "Warning: " << w.message << "\n";
+        if (!s.sem.getErrors().empty()) {
+            for (auto &err : s.sem.getErrors()) cerr << where(err.offset) << "Error: " << err.message << "\n";
+            return;
+        }
+
+        Value res = s.vm.execSingle(code);
+        if (auto t = compiler.resultType()) printValue(res, *t);
+    }
+};
+
+// Runs a file through the pipeline, stopping at the first error. The file
+// stays mapped, so tokens keep their file offsets.
+static int runFile(const char *path, Session &s) {
+    SourceBuffer src(path);
+    Locate where = lineColIn(path, src.view());
+    Pipeline pipe(s);
+    try {
+        checkSourceSize(src.view());
+        Lexer lx(src.view());
+        while (true) {
+            Token t = lx.next();
+            if (t.kind == TokenKind::Invalid) throw SourceError(t.offset, "Lexer: invalid char '" + string(src.view().substr(t.offset, 1)) + "'");
+            if (t.kind == TokenKind::End) {
+                if (pipe.pending()) pipe.run(src.view(), where);
+                break;
+            }
+            pipe.push(t);
+            if (t.kind == TokenKind::Semicolon) {
+                pipe.run(src.view(), where);
+                pipe.discard();
+            }
+        }
+    } catch (const exception &ex) {
+        reportError(ex, where);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
 }
 
+// Compiles a whole file through the IR and writes the optimized IR
+// (--dump-ir) or a NASM program (--asm) to stdout instead of running it.
+static int compileFile(const char *path, Session &s, bool toAsm) {
+    SourceBuffer src(path);
+    Locate where = lineColIn(path, src.view());
+    try {
+        checkSourceSize(src.view());
+        TokenStream toks = tokenize(src.view());
+        Parser parser(toks, s.ast, s.share ? &s.cons : nullptr);
+        auto prog = parser.parseProgram();
+        s.sem.analyzeProgram(prog);
+        for (auto &w : s.sem.getWarnings()) cerr << where(w.offset) << "Warning: " << w.message << "\n";
+        if (!s.sem.getErrors().empty()) {
+            for (auto &e : s.sem.getErrors()) cerr << where(e.offset) << "Error: " << e.message << "\n";
+            return EXIT_FAILURE;
+        }
+        ir::Function f = ir::build(prog);
+        ir::PassManager passes = ir::PassManager::standard();
+        passes.verifyEach = true;
+        passes.run(f);
+        if (toAsm) ir::lowerToNasm(f, cout);
+        else ir::dump(f, cout);
+    } catch (const exception &ex) {
+        reportError(ex, where);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
+// Streams statements from fd through the pipeline. Like the REPL, an error
+// discards the rest of the current statement only. The stream window does
+// not keep a statement's text alive, so its tokens are copied into `text`
+// (space separated) as they arrive. Lines are not tracked either, so
+// diagnostics give the stream byte offset, which `origin` maps statement
+// tokens back to.
+static int runStream(int fd, Session &s) {
+    StreamLexer lx(fd);
+    Pipeline pipe(s);
+    string text;
+    vector<uint32_t> origin;
+    Locate streamAt = [](uint32_t off) { return "<stdin>: byte " + to_string(off) + ": "; };
+    Locate stmtAt = [&](uint32_t off) {
+        const TokenStream &stmt = pipe.tokens();
+        if (origin.empty() || stmt.empty()) return streamAt(0);
+        size_t lo = 0, hi = min(origin.size(), stmt.size());  // last token starting at or before off
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            (stmt.offset(mid) <= off ? lo : hi) = mid;
+        }
+        return streamAt(origin[lo]);
+    };
+    auto reset = [&] {
+        pipe.discard();
+        text.clear();
+        origin.clear();
+    };
+    bool skipping = false, failed = false;
+    while (true) {
+        bool complete = false;  // the pipeline holds a whole statement
+        try {
+            Token t = lx.next();
+            if (t.kind == TokenKind::End) {
+                if (pipe.pending() && !skipping) {
+                    complete = true;
+                    pipe.run(text, stmtAt);
+                }
+                break;
+            }
+            bool last = t.kind == TokenKind::Semicolon;
+            if (skipping) {
+                skipping = !last;
+                continue;
+            }
+            if (t.kind == TokenKind::Invalid) throw SourceError(t.offset, "Lexer: invalid char '" + string(lx.lastText()) + "'");
+            origin.push_back(t.offset);
+            t.offset = uint32_t(text.size());
+            text += lx.lastText();
+            text += ' ';
+            pipe.push(t);
+            if (last) {
+                complete = true;
+                pipe.run(text, stmtAt);
+                reset();
+            }
+        } catch (const StreamLexer::TokenTooLong &ex) {
+            reportError(ex, streamAt);
+            return EXIT_FAILURE;
+        } catch (const exception &ex) {
+            // Statement errors carry offsets into `text`, lexer errors stream offsets.
+            reportError(ex, complete ? stmtAt : streamAt);
+            failed = true;
+            skipping = !complete;
+            reset();
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
 /* ------------------- Main: REPL glue ------------------- */
-int main() {
+// Usage: final [-O0 | --share] [--regs | --ir] [file | -]
+//        final [--share] (--dump-ir | --asm) file
+// -O0 compiles straight from tokens to code without building trees, for the
+// lowest compile latency; see DirectCompiler. --share parses into a DAG with
+// repeated subexpressions computed once; see HashCons. --regs runs register
+// code instead of stack code; see RegCode. --ir compiles through the IR and
+// its passes; see ir::Function. --dump-ir and --asm compile a whole file
+// through the IR and print it, or a NASM program for x86-64 Linux, instead
+// of running it.
+int main(int argc, char *argv[]) {
+    Session session;
+    bool dumpIr = false, toAsm = false;
+    for (; argc >= 2 && argv[1][0] == '-' && argv[1][1]; --argc, ++argv) {
+        string_view opt = argv[1];
+        if (opt == "--share") session.share = true;
+        else if (opt == "-O0") session.direct = true;
+        else if (opt == "--regs") session.regs = true;
+        else if (opt == "--ir") session.ir = true;
+        else if (opt == "--dump-ir") dumpIr = true;
+        else if (opt == "--asm") toAsm = true;
+        else {
+            cerr << "Usage: final [-O0 | --share] [--regs | --ir] [file | -]\n"
+                    "       final [--share] (--dump-ir | --asm) file\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (session.share && session.direct) {
+        cerr << "final: -O0 builds no tree for --share to share\n";
+        return EXIT_FAILURE;
+    }
+    if (session.regs && session.direct) {
+        cerr << "final: -O0 emits stack code only\n";
+        return EXIT_FAILURE;
+    }
+    if ((session.ir || dumpIr || toAsm) && session.direct) {
+        cerr << "final: -O0 builds no tree for the IR\n";
+        return EXIT_FAILURE;
+    }
+    if (session.ir && session.regs) {
+        cerr << "final: --ir lowers to stack code only\n";
+        return EXIT_FAILURE;
+    }
+    if (dumpIr || toAsm) {
+        if (argc != 2 || string_view(argv[1]) == "-" || (dumpIr && toAsm) || session.ir || session.regs) {
+            cerr << "Usage: final [--share] (--dump-ir | --asm) file\n";
+            return EXIT_FAILURE;
+        }
+        return compileFile(argv[1], session, toAsm);
+    }
+    if (argc == 2 && string_view(argv[1]) == "-") return runStream(STDIN_FILENO, session);
+    if (argc == 2) return runFile(argv[1], session);
+
     cout << "Supports print. Enter statements; use ';' to separate. Empty line quits.\n";
-    SemanticAnalyzer sem;
-    VM vm;
 
     while (true) {
         cout << "> ";
@@ -447,45 +2840,17 @@ int main() {
         if (line.empty()) break;
         if (line == "exit" || line == "quit") break;
 
+        Locate where = lineColIn("<input>", line);
         try {
             // 1) tokenize
-            Lexer lx(line);
-            vector<Token> toks;
-            while (true) {
-                Token t = lx.next();
-                if (t.kind == TokenKind::Invalid) throw runtime_error("Lexer: invalid char '" + t.text + "'");
-                if (t.kind == TokenKind::End) break;
-                toks.push_back(move(t));
-            }
-            toks.push_back({TokenKind::End, ""});
-
-            // 2) parse program
-            Parser parser(toks);
-            auto prog = parser.parseProgram();
-
-            // 3) semantic analyze
-            sem.analyzeProgram(prog);
-            for (auto &w : sem.getWarnings()) cerr << "Warning: " << w << "\n";
-            if (!sem.getErrors().empty()) {
-                for (auto &e : sem.getErrors()) cerr << "Error: " << e << "\n";
-                continue;
-            }
-
-            // 4) for each statement: codegen & run
-            for (auto &stmt : prog) {
-                auto code = genForStmt(stmt);
-                double res = vm.execSingle(code);
-                // If statement not a print, print REPL result
-                if (!dynamic_cast<PrintExpr*>(stmt.get())) {
-                    // print numeric result for expressions/assignments
-                    cout << res << "\n";
-                }
-            }
+            runTokens(tokenize(line), session, where);
         } catch (const exception &ex) {
-            cerr << "Error: " << ex.what() << "\n";
+            reportError(ex, where);
         }
+        session.sem.settle(session.vm);
     }
 
     cout << "Goodbye.\n";
     return 0;
 }
+#endif
@@ -1,7 +1,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <cctype>
+
+#include "lex_table.hpp"
 
 
 enum class TokenType {
@@ -11,7 +12,8 @@ enum class TokenType {
     Equals,
     LParen, RParen,
     LBrace, RBrace,
-    EndOfFile
+    EndOfFile,
+    Invalid
 };
 
 struct Token {
@@ -19,6 +21,15 @@ struct Token {
     std::string value;
 };
 
+static constexpr lex::Dfa kTokenDfa = lex::make_dfa({.underscoreIdent = false, .fractions = false});
+static constexpr lex::PunctTable<TokenType> kPuncts = lex::make_punct_table<TokenType>({
+    {'+', TokenType::Plus},   {'-', TokenType::Minus},
+    {'*', TokenType::Star},   {'/', TokenType::Slash},
+    {'=', TokenType::Equals},
+    {'(', TokenType::LParen}, {')', TokenType::RParen},
+    {'{', TokenType::LBrace}, {'}', TokenType::RBrace},
+}, TokenType::Invalid);
+
 class Lexer {
     std::string text;
     size_t pos;
@@ -33,25 +44,7 @@ public:
     void advance() { pos++; }
 
     void skipWhitespace() {
-        while (isspace(currentChar())) advance();
-    }
-
-    Token number() {
-        std::string result;
-        while (isdigit(currentChar())) {
-            result += currentChar();
-            advance();
-        }
-        return {TokenType::Number, result};
-    }
-
-    Token identifier() {
-        std::string result;
-        while (isalnum(currentChar())) {
-            result += currentChar();
-            advance();
-        }
-        return {TokenType::Identifier, result};
+        pos = scan::skip_space(text.data() + pos, text.data() + text.size()) - text.data();
     }
 
     Token getNextToken() {
@@ -59,23 +52,20 @@ public:
 
         char ch = currentChar();
         if (ch == '\0') return {TokenType::EndOfFile, ""};
-        if (isdigit(ch)) return number();
-        if (isalpha(ch)) return identifier();
-
-        switch (ch) {
-            case '+': advance(); return {TokenType::Plus, "+"};
-            case '-': advance(); return {TokenType::Minus, "-"};
-            case '*': advance(); return {TokenType::Star, "*"};
-            case '/': advance(); return {TokenType::Slash, "/"};
-            case '=': advance(); return {TokenType::Equals, "="};
-            case '(': advance(); return {TokenType::LParen, "("};
-            case ')': advance(); return {TokenType::RParen, ")"};
-            case '{': advance(); return {TokenType::LBrace, "{"};
-            case '}': advance(); return {TokenType::RBrace, "}"};
+
+        size_t start = pos;
+        lex::Match m = lex::match(kTokenDfa, text.data() + pos, text.data() + text.size());
+        if (m.shape != lex::Shape::None) {
+            pos = m.end - text.data();
+            TokenType type = m.shape == lex::Shape::Number ? TokenType::Number : TokenType::Identifier;
+            return {type, text.substr(start, pos - start)};
         }
 
-        std::cerr << "Unknown character: " << ch << "\n";
         advance();
+        TokenType type = kPuncts[(unsigned char)ch];
+        if (type != TokenType::Invalid) return {type, std::string(1, ch)};
+
+        std::cerr << "Unknown character: " << ch << "\n";
         return getNextToken();
     }
 };
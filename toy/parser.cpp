@@ -3,6 +3,8 @@
 #include <string>
 #include <cctype>
 
+#include "number.hpp"
+
 enum class TokenType { Number, Plus, Minus, Mul, Div, LParen, RParen, End };
 
 struct Token {
@@ -72,7 +74,9 @@ public:
     int parseFactor() {
         Token t = get();
         if (t.type == TokenType::Number) {
-            return std::stoi(t.value);
+            int value = 0;
+            if (!lex::parse_int(t.value, value)) throw std::runtime_error("Number out of range");
+            return value;
         } else if (t.type == TokenType::LParen) {
             int value = parseExpr();
             if (peek().type != TokenType::RParen) {
@@ -1,11 +1,17 @@
+#include <cstdint>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <cctype>
-#include <memory>
+#include <string_view>
 #include <stdexcept>
 #include <unordered_map>
 
+#include "arena.hpp"
+#include "node_visit.hpp"
+#include "number.hpp"
+#include "op_table.hpp"
+
 // =====================
 //  TOKENS
 // =====================
@@ -19,20 +25,21 @@ enum class TokenType {
     End
 };
 
+// text views the Lexer's input, which the caller keeps alive.
 struct Token {
     TokenType type;
-    std::string text;
+    std::string_view text;
 };
 
 // =====================
 //  LEXER
 // =====================
 class Lexer {
-    std::string input;
+    std::string_view input;
     size_t pos = 0;
 
 public:
-    Lexer(const std::string& s) : input(s) {}
+    Lexer(std::string_view s) : input(s) {}
 
     Token next() {
         while (pos < input.size() && isspace(input[pos])) pos++;
@@ -41,20 +48,15 @@ public:
 
         char c = input[pos];
 
+        size_t start = pos;
         if (isdigit(c)) {
-            std::string num;
-            while (pos < input.size() && isdigit(input[pos])) {
-                num.push_back(input[pos++]);
-            }
-            return {TokenType::Number, num};
+            while (pos < input.size() && isdigit(input[pos])) pos++;
+            return {TokenType::Number, input.substr(start, pos - start)};
         }
 
         if (isalpha(c)) {
-            std::string id;
-            while (pos < input.size() && isalnum(input[pos])) {
-                id.push_back(input[pos++]);
-            }
-            return {TokenType::Identifier, id};
+            while (pos < input.size() && isalnum(input[pos])) pos++;
+            return {TokenType::Identifier, input.substr(start, pos - start)};
         }
 
         pos++;
@@ -76,47 +78,64 @@ public:
 // =====================
 //  AST NODES
 // =====================
+// Nodes are allocated from an Arena and released with it.
+enum class ExprKind : uint8_t { Number, Var, Assign, Binary };
+
 struct Expr {
+    const ExprKind kind;
+    explicit Expr(ExprKind k) : kind(k) {}
     virtual ~Expr() = default;
 };
 
 struct NumberExpr : Expr {
     int value;
-    NumberExpr(int v) : value(v) {}
+    NumberExpr(int v) : Expr(ExprKind::Number), value(v) {}
 };
 
 struct VarExpr : Expr {
-    std::string name;
-    VarExpr(const std::string& n) : name(n) {}
+    std::string_view name;
+    VarExpr(std::string_view n) : Expr(ExprKind::Var), name(n) {}
 };
 
 struct AssignExpr : Expr {
-    std::string name;
-    std::unique_ptr<Expr> value;
-    AssignExpr(const std::string& n, std::unique_ptr<Expr> v)
-    : name(n), value(std::move(v)) {}
+    std::string_view name;
+    Expr* value;
+    AssignExpr(std::string_view n, Expr* v) : Expr(ExprKind::Assign), name(n), value(v) {}
 };
 
 struct BinaryExpr : Expr {
     char op;
-    std::unique_ptr<Expr> left, right;
-    BinaryExpr(char o, std::unique_ptr<Expr> l, std::unique_ptr<Expr> r)
-    : op(o), left(std::move(l)), right(std::move(r)) {}
+    Expr *left, *right;
+    BinaryExpr(char o, Expr* l, Expr* r) : Expr(ExprKind::Binary), op(o), left(l), right(r) {}
 };
 
+// Hands e to eval's lambdas as its node type, listed in ExprKind order.
+template <class F>
+decltype(auto) visitExpr(Expr& e, F&& f) {
+    return ast::visit_kind<NumberExpr, VarExpr, AssignExpr, BinaryExpr>(e, f);
+}
+
 // =====================
 //  PARSER
 // =====================
+static constexpr auto kOps = parse::make_op_table<TokenType>({
+    {TokenType::Plus, '+', 1}, {TokenType::Minus, '-', 1},
+    {TokenType::Star, '*', 2}, {TokenType::Slash, '/', 2},
+});
+
+// Reads the caller's token vector in place; names in the tree view the
+// source line, so neither is copied.
 class Parser {
-    std::vector<Token> tokens;
+    const std::vector<Token>& tokens;
+    Arena& arena;
     size_t pos = 0;
 
-    Token& peek() {
+    const Token& peek() {
         if (pos >= tokens.size()) throw std::runtime_error("Unexpected end");
         return tokens[pos];
     }
 
-    Token get() { return tokens[pos++]; }
+    const Token& get() { return tokens[pos++]; }
 
     bool match(TokenType t) {
         if (pos < tokens.size() && tokens[pos].type == t) {
@@ -127,26 +146,26 @@ class Parser {
     }
 
 public:
-    Parser(std::vector<Token> toks) : tokens(std::move(toks)) {}
+    Parser(const std::vector<Token>& toks, Arena& a) : tokens(toks), arena(a) {}
 
     // Parse multiple statements
-    std::vector<std::unique_ptr<Expr>> parseProgram() {
-        std::vector<std::unique_ptr<Expr>> stmts;
+    std::vector<Expr*> parseProgram() {
+        std::vector<Expr*> stmts;
         while (pos < tokens.size() && peek().type != TokenType::End) {
             auto stmt = parseStatement();
-            stmts.push_back(std::move(stmt));
+            stmts.push_back(stmt);
             match(TokenType::Semicolon); // optional ;
         }
         return stmts;
     }
 
 private:
-    std::unique_ptr<Expr> parseStatement() {
+    Expr* parseStatement() {
         if (peek().type == TokenType::Identifier) {
-            Token id = get();
+            const Token& id = get();
             if (match(TokenType::Assign)) {
                 auto val = parseExpression();
-                return std::make_unique<AssignExpr>(id.text, std::move(val));
+                return arena.make<AssignExpr>(id.text, val);
             } else {
                 pos--; // rollback
             }
@@ -154,42 +173,60 @@ private:
         return parseExpression();
     }
 
-    std::unique_ptr<Expr> parseExpression() {
-        auto node = parseTerm();
-        while (pos < tokens.size() &&
-            (peek().type == TokenType::Plus || peek().type == TokenType::Minus)) {
-            char op = get().text[0];
-        auto rhs = parseTerm();
-        node = std::make_unique<BinaryExpr>(op, std::move(node), std::move(rhs));
+    // One statement's expression, up to its ';' or the end of the line.
+    // ops holds '(' and operators not yet applied, vals the operands; a
+    // looser operator or a ')' folds pending ones into BinaryExprs by kOps
+    // binding power (see op_table.hpp). Nothing here recurses.
+    Expr* parseExpression() {
+        std::vector<Pending> ops;
+        std::vector<Expr*> vals;
+        auto reduce = [&] {
+            Pending p = ops.back();
+            ops.pop_back();
+            Expr* rhs = vals.back();
+            vals.pop_back();
+            vals.back() = arena.make<BinaryExpr>(p.infix.op, vals.back(), rhs);
+        };
+        size_t open = 0;  // '(' on ops
+        while (true) {
+            // Operand, after any '('.
+            while (peek().type == TokenType::LParen) {
+                get();
+                ops.push_back({true});
+                ++open;
             }
-            return node;
-    }
-
-    std::unique_ptr<Expr> parseTerm() {
-        auto node = parseFactor();
-        while (pos < tokens.size() &&
-            (peek().type == TokenType::Star || peek().type == TokenType::Slash)) {
-            char op = get().text[0];
-        auto rhs = parseFactor();
-        node = std::make_unique<BinaryExpr>(op, std::move(node), std::move(rhs));
+            const Token& tok = get();
+            if (tok.type == TokenType::Number) {
+                int value = 0;
+                if (!lex::parse_int(tok.text, value))
+                    throw std::runtime_error("Number out of range: " + std::string(tok.text));
+                vals.push_back(arena.make<NumberExpr>(value));
+            } else if (tok.type == TokenType::Identifier) {
+                vals.push_back(arena.make<VarExpr>(tok.text));
+            } else {
+                throw std::runtime_error("Unexpected token: " + std::string(tok.text));
             }
-            return node;
-    }
 
-    std::unique_ptr<Expr> parseFactor() {
-        Token tok = get();
-        if (tok.type == TokenType::Number) {
-            return std::make_unique<NumberExpr>(std::stoi(tok.text));
-        } else if (tok.type == TokenType::Identifier) {
-            return std::make_unique<VarExpr>(tok.text);
-        } else if (tok.type == TokenType::LParen) {
-            auto expr = parseExpression();
-            if (!match(TokenType::RParen))
-                throw std::runtime_error("Missing ')'");
-            return expr;
+            // Operator, after any ')' closing groups.
+            while (open > 0 && match(TokenType::RParen)) {
+                while (!ops.back().paren) reduce();
+                ops.pop_back();
+                --open;
+            }
+            if (pos >= tokens.size() || kOps[tokens[pos].type].lbp == 0) break;
+            parse::Infix op = kOps[get().type];
+            while (!ops.empty() && !ops.back().paren && ops.back().infix.rbp >= op.lbp) reduce();
+            ops.push_back({false, op});
         }
-        throw std::runtime_error("Unexpected token: " + tok.text);
+        if (open > 0) throw std::runtime_error("Missing ')'");
+        while (!ops.empty()) reduce();
+        return vals.back();
     }
+
+    struct Pending {
+        bool paren;
+        parse::Infix infix {};
+    };
 };
 
 // =====================
@@ -197,29 +234,58 @@ private:
 // =====================
 std::unordered_map<std::string, int> variables;
 
-int eval(Expr* expr) {
-    if (auto num = dynamic_cast<NumberExpr*>(expr)) {
-        return num->value;
-    } else if (auto var = dynamic_cast<VarExpr*>(expr)) {
-        if (variables.find(var->name) == variables.end())
-            throw std::runtime_error("Undefined variable: " + var->name);
-        return variables[var->name];
-    } else if (auto assign = dynamic_cast<AssignExpr*>(expr)) {
-        int val = eval(assign->value.get());
-        variables[assign->name] = val;
-        return val;
-    } else if (auto bin = dynamic_cast<BinaryExpr*>(expr)) {
-        int left = eval(bin->left.get());
-        int right = eval(bin->right.get());
-        switch (bin->op) {
-            case '+': return left + right;
-            case '-': return left - right;
-            case '*': return left * right;
-            case '/': if (right == 0) throw std::runtime_error("Divide by zero");
-            return left / right;
+// One statement's value; main prints it for each statement on the line.
+// Nodes are queued on stack, expanded once into their children, and then
+// computed from the results left on values, without recursing.
+int eval(Expr* root) {
+    struct Frame { Expr* e; bool expanded; };
+    std::vector<Frame> stack{{root, false}};
+    std::vector<int> values;
+    while (!stack.empty()) {
+        auto [expr, expanded] = stack.back();
+        if (!expanded) {
+            stack.back().expanded = true;
+            visitExpr(*expr, ast::Overloaded{
+                [&](AssignExpr& assign) { stack.push_back({assign.value, false}); },
+                [&](BinaryExpr& bin) {
+                    stack.push_back({bin.right, false});
+                    stack.push_back({bin.left, false});
+                },
+                [](auto&) {},
+            });
+            continue;
         }
+        stack.pop_back();
+
+        visitExpr(*expr, ast::Overloaded{
+            [&](NumberExpr& num) { values.push_back(num.value); },
+            [&](VarExpr& var) {
+                std::string name(var.name);
+                auto it = variables.find(name);
+                if (it == variables.end())
+                    throw std::runtime_error("Undefined variable: " + name);
+                values.push_back(it->second);
+            },
+            [&](AssignExpr& assign) { variables[std::string(assign.name)] = values.back(); },
+            [&](BinaryExpr& bin) {
+                int right = values.back();
+                values.pop_back();
+                int left = values.back();
+                switch (bin.op) {
+                    case '+': values.back() = left + right; break;
+                    case '-': values.back() = left - right; break;
+                    case '*': values.back() = left * right; break;
+                    case '/': {
+                        if (right == 0) throw std::runtime_error("Divide by zero");
+                        values.back() = left / right;
+                        break;
+                    }
+                    default: throw std::runtime_error("Unknown expression type");
+                }
+            },
+        });
     }
-    throw std::runtime_error("Unknown expression type");
+    return values.back();
 }
 
 // =====================
@@ -228,6 +294,7 @@ int eval(Expr* expr) {
 int main() {
     std::cout << "Mini Compiler with Multiple Statements + REPL. Type 'exit' to quit.\n";
 
+    Arena arena;
     while (true) {
         std::cout << "> ";
         std::string line;
@@ -242,11 +309,12 @@ int main() {
                 tokens.push_back(t);
             }
 
-            Parser parser(tokens);
+            arena.reset();
+            Parser parser(tokens, arena);
             auto stmts = parser.parseProgram();
 
             for (auto& stmt : stmts) {
-                int result = eval(stmt.get());
+                int result = eval(stmt);
                 std::cout << result << "\n";
             }
         } catch (std::exception& e) {